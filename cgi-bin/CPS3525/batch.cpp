@@ -0,0 +1,335 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <thread>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "get_validate_input.h" // For loading grid files and parsing pattern lists
+#include "pattern_analyzer.h" // For the analysis itself
+#include "grid_index.h" // For --index
+#include "result_cache.h" // For the grid hash an index is checked against
+#include "thread_pool.h" // For analyzing files in parallel
+
+using namespace std;
+
+// Offline driver: analyzes grid files (same "rows cols" + rows format as the upload) for a list of
+// patterns without a web server, and writes per-file counts and accepted locations as CSV or JSON.
+// Usage: project3_batch --patterns P1,P2,... [--format csv|json] [--directions hv|all] [--threads N] [--band-rows N] [--index] [--out FILE] PATH...
+// A PATH that is a directory contributes every regular file in it (not recursive), in name order,
+// except saved indexes (*.idx).
+// With --directions all, words are also found backwards and diagonally.
+// With --band-rows each file is analyzed out of core, N rows at a time, so grids larger than memory
+// work; files must then be in the plain one-row-per-line layout, and only hv directions are searched.
+// With --index each grid FILE is searched through a position index kept next to it as FILE.idx: it is
+// mapped if it is there and matches the grid, otherwise built and saved. Worth it when the same grids
+// are queried again with other patterns; hv directions only. Saved indexes named as PATHs (e.g. by a
+// shell glob over the grids) are then skipped too.
+// Locations are 0-based row and column of the first character and the direction code (H, V, or with
+// all directions h, v, D, d, A, a; see pattern_analyzer::Direction). The exit status is 1 if any file failed.
+
+struct BatchConfig {
+    vector<string> patterns;
+    bool json = false;
+    pattern_analyzer::DirectionSet directions = pattern_analyzer::HORIZONTAL_VERTICAL;
+    int threads = 0; // 0 = one per hardware thread
+    int band_rows = 0; // 0 = load each grid whole
+    bool index = false;
+    string out_file;
+    vector<string> paths;
+};
+
+// Outcome for one file: its formatted output, or the reason it could not be analyzed
+struct FileReport {
+    string output;
+    bool ok = false;
+};
+
+static bool is_directory(const string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+// Expands directories into their regular files; plain paths are kept as given
+// True for the name of a saved index (FILE.idx)
+static bool is_saved_index(const string& name) {
+    return name.size() > 4 && name.compare(name.size() - 4, 4, ".idx") == 0;
+}
+
+// The files named by paths; with skip_indexes, saved indexes named directly are left out as well
+static vector<string> collect_files(const vector<string>& paths, bool skip_indexes) {
+    vector<string> files;
+    for (const string& path : paths) {
+        if (!is_directory(path)) {
+            if (!(skip_indexes && is_saved_index(path))) files.push_back(path);
+            continue;
+        }
+        vector<string> entries;
+        DIR* dir = opendir(path.c_str());
+        if (dir == nullptr) {
+            files.push_back(path); // Reported as unreadable below
+            continue;
+        }
+        while (dirent* entry = readdir(dir)) {
+            string full = path + "/" + entry->d_name;
+            struct stat info;
+            string name = entry->d_name;
+            if (name[0] != '.' && !is_saved_index(name) && stat(full.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+                entries.push_back(full);
+            }
+        }
+        closedir(dir);
+        sort(entries.begin(), entries.end());
+        files.insert(files.end(), entries.begin(), entries.end());
+    }
+    return files;
+}
+
+static string json_string(const string& s) {
+    string quoted = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+// CSV fields are quoted when they contain a separator, a quote or a line break
+static string csv_field(const string& s) {
+    if (s.find_first_of(",\"\r\n") == string::npos) {
+        return s;
+    }
+    string quoted = "\"";
+    for (char c : s) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// First line of a parse_grid message, without the trailing newline
+static string first_line(const string& message) {
+    return message.substr(0, message.find('\n'));
+}
+
+// CSV: one line per (file, pattern): file,pattern,count,locations,error with the locations
+// written as row:col:direction separated by spaces
+static void format_csv(const string& path, const vector<string>& patterns, const vector<pattern_analyzer::AnalysisResult>* results,
+                       const string& error, string& out) {
+    for (size_t p = 0; p < patterns.size(); ++p) {
+        out += csv_field(path) + "," + patterns[p] + ",";
+        if (results != nullptr) {
+            const pattern_analyzer::AnalysisResult& result = (*results)[p];
+            out += to_string(result.count) + ",";
+            for (size_t i = 0; i < result.locations.size(); ++i) {
+                const pattern_analyzer::PatternLocation& loc = result.locations[i];
+                if (i) out += ' ';
+                out += to_string(loc.row) + ":" + to_string(loc.col) + ":" + loc.direction;
+            }
+            out += ",\n";
+        } else {
+            out += ",," + csv_field(error) + "\n";
+        }
+    }
+}
+
+// JSON: one object per file, written as one line so files can be streamed and grepped
+static void format_json(const string& path, int rows, int cols, const vector<string>& patterns,
+                        const vector<pattern_analyzer::AnalysisResult>* results, const string& error, string& out) {
+    out += "{\"file\": " + json_string(path);
+    if (results == nullptr) {
+        out += ", \"error\": " + json_string(error) + "}";
+        return;
+    }
+    out += ", \"rows\": " + to_string(rows) + ", \"cols\": " + to_string(cols) + ", \"results\": [";
+    for (size_t p = 0; p < patterns.size(); ++p) {
+        const pattern_analyzer::AnalysisResult& result = (*results)[p];
+        out += p ? ", " : "";
+        out += "{\"pattern\": " + json_string(patterns[p]) + ", \"count\": " + to_string(result.count) + ", \"locations\": [";
+        for (size_t i = 0; i < result.locations.size(); ++i) {
+            const pattern_analyzer::PatternLocation& loc = result.locations[i];
+            out += i ? ", [" : "[";
+            out += to_string(loc.row) + ", " + to_string(loc.col) + ", \"" + loc.direction + "\"]";
+        }
+        out += "]}";
+    }
+    out += "]}";
+}
+
+// Analyzes one file band by band, one pass over the file per pattern. Only the accepted
+// locations are kept; the grid itself and its occupancy never are in full.
+static bool analyze_file_tiled(const string& path, const BatchConfig& config, int& rows, int& cols,
+                               vector<pattern_analyzer::AnalysisResult>& results, string& error) {
+    get_validate_input::GridRowReader reader;
+    ostringstream messages;
+    if (!reader.open(path, messages)) {
+        error = first_line(messages.str());
+        return false;
+    }
+    rows = reader.rows();
+    cols = reader.cols();
+    results.resize(config.patterns.size());
+    for (size_t p = 0; p < config.patterns.size(); ++p) {
+        vector<pattern_analyzer::PatternLocation>& locations = results[p].locations;
+        long long count = 0;
+        bool ok = pattern_analyzer::analyze_pattern_tiled(reader.rows(), reader.cols(),
+            [&](int first, int n, char* out) { return reader.read_rows(first, n, out); },
+            config.patterns[p], config.band_rows,
+            [&](const pattern_analyzer::PatternLocation& loc) { locations.push_back(loc); }, count);
+        if (!ok) {
+            error = "Error: Could not read the file, or it has a row that is not " + to_string(reader.cols()) + " uppercase characters.";
+            return false;
+        }
+        results[p].count = count;
+    }
+    return true;
+}
+
+// Maps the saved index of grid, or builds and saves one (saving is best effort)
+static bool open_index(const string& index_path, const pattern_grid::Grid& grid, grid_index::GridIndex& index) {
+    uint64_t grid_hash = result_cache::hash_grid(grid);
+    if (index.load(index_path, grid.rows(), grid.cols(), grid_hash)) {
+        return true;
+    }
+    if (!index.build(grid, grid_hash)) {
+        return false;
+    }
+    index.save(index_path);
+    return true;
+}
+
+// Maps, parses and analyzes one file; long pattern lists share one scan of the grid (or its index)
+static void analyze_file(const string& path, const BatchConfig& config, FileReport& report) {
+    int rows = 0;
+    int cols = 0;
+    string error;
+    vector<pattern_analyzer::AnalysisResult> results;
+    pattern_grid::Grid grid;
+    ostringstream messages;
+    if (config.band_rows > 0) {
+        report.ok = analyze_file_tiled(path, config, rows, cols, results, error);
+    } else if (get_validate_input::load_grid_file(path, grid, messages)) {
+        rows = grid.rows();
+        cols = grid.cols();
+        grid_index::GridIndex index;
+        if (config.index && open_index(path + ".idx", grid, index)) {
+            for (const string& pattern : config.patterns) {
+                results.push_back(grid_index::analyze_pattern(grid, pattern, index));
+            }
+        } else if (config.patterns.size() == 1) {
+            results.push_back(pattern_analyzer::analyze_pattern(grid, config.patterns[0], config.directions));
+        } else {
+            // Shares one automaton scan only for long pattern lists (see automaton_threshold)
+            results = pattern_analyzer::analyze_patterns(grid, config.patterns, config.directions);
+        }
+        report.ok = true;
+    } else {
+        error = first_line(messages.str());
+    }
+    const vector<pattern_analyzer::AnalysisResult>* analyzed = report.ok ? &results : nullptr;
+    if (config.json) {
+        format_json(path, rows, cols, config.patterns, analyzed, error, report.output);
+    } else {
+        format_csv(path, config.patterns, analyzed, error, report.output);
+    }
+}
+
+static bool parse_args(int argc, char* argv[], BatchConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            config.paths.push_back(arg);
+            continue;
+        }
+        if (arg == "--index") {
+            config.index = true;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        string value = argv[++i];
+        if (arg == "--patterns") config.patterns = get_validate_input::split_list(value);
+        else if (arg == "--format" && (value == "csv" || value == "json")) config.json = (value == "json");
+        else if (arg == "--directions" && (value == "hv" || value == "all")) config.directions = (value == "all") ? pattern_analyzer::ALL_DIRECTIONS : pattern_analyzer::HORIZONTAL_VERTICAL;
+        else if (arg == "--threads") config.threads = atoi(value.c_str());
+        else if (arg == "--band-rows" && atoi(value.c_str()) > 0) config.band_rows = atoi(value.c_str());
+        else if (arg == "--out") config.out_file = value;
+        else return false;
+    }
+    for (const string& pattern : config.patterns) {
+        if (!get_validate_input::is_uppercase(pattern)) {
+            cerr << "Invalid pattern '" << pattern << "': expected one or more uppercase letters." << endl;
+            return false;
+        }
+    }
+    if (config.band_rows > 0 && config.directions != pattern_analyzer::HORIZONTAL_VERTICAL) {
+        cerr << "--band-rows only supports --directions hv." << endl;
+        return false;
+    }
+    if (config.index && (config.band_rows > 0 || config.directions != pattern_analyzer::HORIZONTAL_VERTICAL)) {
+        cerr << "--index only supports --directions hv, without --band-rows." << endl;
+        return false;
+    }
+    return !config.patterns.empty() && !config.paths.empty() && config.threads >= 0;
+}
+
+int main(int argc, char* argv[]) {
+    BatchConfig config;
+    if (!parse_args(argc, argv, config)) {
+        cerr << "Usage: " << argv[0] << " --patterns P1,P2,... [--format csv|json] [--directions hv|all] [--threads N] [--band-rows N] [--index] [--out FILE] PATH..." << endl;
+        return 2;
+    }
+
+    vector<string> files = collect_files(config.paths, config.index);
+    vector<FileReport> reports(files.size());
+
+    int threads = config.threads > 0 ? config.threads : max(1u, thread::hardware_concurrency());
+    if (files.size() > 1) {
+        // Files already keep every thread busy; splitting each grid as well would only oversubscribe
+        pattern_analyzer::set_parallel_threshold(SIZE_MAX);
+    }
+    thread_pool::ThreadPool workers(max(1, threads - 1)); // The calling thread takes files too
+    workers.for_each_band(files.size(), [&](int i) {
+        analyze_file(files[i], config, reports[i]);
+    });
+
+    ofstream file_out;
+    if (!config.out_file.empty()) {
+        file_out.open(config.out_file.c_str());
+        if (!file_out) {
+            cerr << "Could not open " << config.out_file << " for writing" << endl;
+            return 1;
+        }
+    }
+    ostream& out = config.out_file.empty() ? cout : file_out;
+
+    bool all_ok = true;
+    if (config.json) out << "[\n";
+    else out << "file,pattern,count,locations,error\n";
+    for (size_t i = 0; i < reports.size(); ++i) {
+        all_ok = all_ok && reports[i].ok;
+        out << reports[i].output;
+        if (config.json) out << (i + 1 < reports.size() ? ",\n" : "\n");
+    }
+    if (config.json) out << "]\n";
+    out.flush();
+    if (!out) {
+        cerr << "Could not write the results" << endl;
+        return 1;
+    }
+    return all_ok ? 0 : 1;
+}
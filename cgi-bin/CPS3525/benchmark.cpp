@@ -0,0 +1,358 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <utility>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "get_validate_input.h" // For the parsing benchmark (validate_form is what get_form_data runs)
+#include "pattern_analyzer.h" // For the search benchmarks
+#include "generate_html.h" // For the rendering benchmarks
+#include "html_writer.h" // For writing rendered pages to /dev/null
+#include "match_kernel.h" // For reporting the active kernel
+#include "request_handler.h" // For the end-to-end benchmark
+#include "incremental_analyzer.h" // For the edit benchmark
+#include "grid_index.h" // For the indexed search benchmark
+#include "result_cache.h" // For the grid hash the index is built with
+
+using namespace std;
+
+// Micro and macro benchmarks over deterministic synthetic grids, reported as JSON in the same
+// shape as Google Benchmark's --benchmark_format=json so results can be compared between versions.
+// Usage: project3_benchmark [--sizes 10,100,1000,10000] [--kinds random,low_entropy,all_same,planted]
+//                           [--pattern P] [--filter SUBSTRING] [--min-time SECONDS] [--out FILE]
+// A human-readable table goes to stderr; the JSON goes to stdout or FILE.
+
+struct BenchmarkConfig {
+    vector<int> sizes = {10, 100, 1000, 10000};
+    vector<string> kinds = {"random", "low_entropy", "all_same", "planted"};
+    string pattern; // Empty = a pattern suited to each kind
+    string filter;
+    double min_time = 0.5;
+    string out_file;
+};
+
+struct BenchmarkResult {
+    string name;
+    long long iterations;
+    double real_ns; // Per iteration
+    double cpu_ns;  // Per iteration, all threads of the process
+    double items_per_second; // Grid cells per second
+};
+
+// Keeps benchmarked results alive so the calls are not optimized away
+static volatile long long benchmark_sink;
+
+// Small deterministic generator (splitmix64), so every run and every version sees the same grids
+class GridRandom {
+public:
+    explicit GridRandom(uint64_t seed) : state_(seed) {}
+    uint64_t next() {
+        uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+private:
+    uint64_t state_;
+};
+
+// Pattern used for a kind when --pattern is not given
+static string default_pattern(const string& kind) {
+    if (kind == "low_entropy") return "ABAB";
+    if (kind == "all_same") return "AAA";
+    if (kind == "planted") return "PLANT";
+    return "ABC";
+}
+
+// Builds the upload text ("rows cols" line, then one line per row) for a synthetic grid:
+//   random       letters A-Z uniformly
+//   low_entropy  A or B, three times as many A's as B's
+//   all_same     every cell 'A'
+//   planted      random letters with the pattern written across and down at regular intervals
+static string generate_grid_text(const string& kind, int size, const string& pattern) {
+    GridRandom random(0x5EED0000ULL + size);
+    vector<char> cells(static_cast<size_t>(size) * size);
+    for (char& cell : cells) {
+        if (kind == "all_same") cell = 'A';
+        else if (kind == "low_entropy") cell = (random.next() % 4 == 0) ? 'B' : 'A';
+        else cell = 'A' + random.next() % 26;
+    }
+    if (kind == "planted" && static_cast<int>(pattern.size()) <= size) {
+        int m = pattern.size();
+        int spacing = m * 4;
+        for (int r = 0; r < size; r += spacing) {
+            for (int c = 0; c + m <= size; c += spacing) {
+                for (int i = 0; i < m; ++i) {
+                    cells[static_cast<size_t>(r) * size + c + i] = pattern[i]; // Across
+                    if (r + 1 + i < size && c + m / 2 < size) {
+                        cells[static_cast<size_t>(r + 1 + i) * size + c + m / 2] = pattern[i]; // Down
+                    }
+                }
+            }
+        }
+    }
+
+    string text = to_string(size) + " " + to_string(size) + "\n";
+    text.reserve(text.size() + cells.size() + size);
+    for (int r = 0; r < size; ++r) {
+        text.append(&cells[static_cast<size_t>(r) * size], size);
+        text += '\n';
+    }
+    return text;
+}
+
+// Runs fn until it has taken at least min_time seconds, growing the iteration count like
+// Google Benchmark does, and reports the time of the final batch per iteration
+template <typename Fn>
+static BenchmarkResult run_benchmark(const string& name, double min_time, size_t cells, Fn fn) {
+    long long iterations = 1;
+    for (;;) {
+        chrono::steady_clock::time_point real_start = chrono::steady_clock::now();
+        clock_t cpu_start = clock();
+        for (long long i = 0; i < iterations; ++i) {
+            fn();
+        }
+        double cpu = static_cast<double>(clock() - cpu_start) / CLOCKS_PER_SEC;
+        double real = chrono::duration<double>(chrono::steady_clock::now() - real_start).count();
+
+        if (real >= min_time || iterations >= 1000000000LL) {
+            BenchmarkResult result;
+            result.name = name;
+            result.iterations = iterations;
+            result.real_ns = real * 1e9 / iterations;
+            result.cpu_ns = cpu * 1e9 / iterations;
+            result.items_per_second = real > 0 ? cells * iterations / real : 0;
+            return result;
+        }
+        double scale = real > 0 ? min_time / real * 1.4 : 10;
+        iterations = max(iterations + 1, static_cast<long long>(iterations * min(scale, 10.0)));
+    }
+}
+
+static string json_escape(const string& s) {
+    string escaped;
+    for (char c : s) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+static void write_json(ostream& out, const vector<BenchmarkResult>& results) {
+    char date[64];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"executable\": \"project3_benchmark\",\n"
+        << "    \"num_cpus\": " << sysconf(_SC_NPROCESSORS_ONLN) << ",\n"
+        << "    \"match_kernel\": \"" << match_kernel::active_kernel() << "\",\n"
+        << "    \"parallel_threshold\": " << pattern_analyzer::parallel_threshold() << ",\n"
+        << "    \"automaton_threshold\": " << pattern_analyzer::automaton_threshold() << "\n"
+        << "  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& r = results[i];
+        char times[128];
+        snprintf(times, sizeof(times), "\"real_time\": %.1f, \"cpu_time\": %.1f", r.real_ns, r.cpu_ns);
+        out << (i ? ",\n" : "\n")
+            << "    {\"name\": \"" << json_escape(r.name) << "\", \"run_type\": \"iteration\", \"iterations\": " << r.iterations
+            << ", " << times << ", \"time_unit\": \"ns\", \"items_per_second\": " << static_cast<long long>(r.items_per_second) << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+static vector<string> split_arg(const string& arg) {
+    vector<string> items;
+    stringstream stream(arg);
+    string item;
+    while (getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+static bool parse_args(int argc, char* argv[], BenchmarkConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) return false;
+        string value = argv[++i];
+        if (arg == "--sizes") {
+            config.sizes.clear();
+            for (const string& size : split_arg(value)) {
+                config.sizes.push_back(atoi(size.c_str()));
+                if (config.sizes.back() <= 0) return false;
+            }
+        } else if (arg == "--kinds") config.kinds = split_arg(value);
+        else if (arg == "--pattern") config.pattern = value;
+        else if (arg == "--filter") config.filter = value;
+        else if (arg == "--min-time") config.min_time = atof(value.c_str());
+        else if (arg == "--out") config.out_file = value;
+        else return false;
+    }
+    for (const string& kind : config.kinds) {
+        if (kind != "random" && kind != "low_entropy" && kind != "all_same" && kind != "planted") return false;
+    }
+    return !config.sizes.empty() && config.min_time >= 0;
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkConfig config;
+    if (!parse_args(argc, argv, config)) {
+        cerr << "Usage: " << argv[0] << " [--sizes 10,100,1000,10000] [--kinds random,low_entropy,all_same,planted]"
+             << " [--pattern P] [--filter SUBSTRING] [--min-time SECONDS] [--out FILE]" << endl;
+        return 2;
+    }
+    // Every end-to-end iteration must search again instead of hitting the result cache
+    setenv("PROJECT3_CACHE_ENTRIES", "0", 1);
+    unsetenv("PROJECT3_CACHE_DIR");
+
+    // Rendered pages are written to /dev/null so only generating them is measured
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd < 0) {
+        perror("/dev/null");
+        return 1;
+    }
+    html_writer::Writer discard(null_fd);
+
+    vector<BenchmarkResult> results;
+    char line[160];
+    snprintf(line, sizeof(line), "%-48s %14s %14s %12s\n", "Benchmark", "Time (ns)", "CPU (ns)", "Iterations");
+    cerr << line << string(91, '-') << endl;
+
+    for (const string& kind : config.kinds) {
+        string pattern = config.pattern.empty() ? default_pattern(kind) : config.pattern;
+        for (int size : config.sizes) {
+            string suffix = "/" + kind + "/" + to_string(size) + "x" + to_string(size);
+            size_t cells = static_cast<size_t>(size) * size;
+
+            // The same form the CGI program would receive, with the grid as the uploaded file
+            get_validate_input::FormInput input;
+            input.fields["guess_pattern"] = pattern;
+            input.fields["guess_occurrences"] = "0";
+            input.fields["conversion"] = "convert";
+            input.has_pattern_file = true;
+            input.pattern_file = generate_grid_text(kind, size, pattern);
+
+            pattern_grid::Grid grid;
+            vector<string> patterns;
+            vector<int> occurrences;
+            bool convert;
+            ostringstream errors;
+            if (!get_validate_input::validate_form(input, grid, patterns, occurrences, convert, errors)) {
+                cerr << "Generated grid" << suffix << " was rejected: " << errors.str();
+                return 1;
+            }
+            pattern_analyzer::AnalysisResult analysis = pattern_analyzer::analyze_pattern(grid, pattern);
+            pattern_analyzer::NumberedOverlay numbered = pattern_analyzer::number_occurrences(analysis);
+
+            vector<pair<string, function<void()>>> benchmarks;
+            benchmarks.push_back(make_pair("BM_parse", [&] {
+                pattern_grid::Grid parsed;
+                ostringstream discard_errors;
+                get_validate_input::validate_form(input, parsed, patterns, occurrences, convert, discard_errors);
+                benchmark_sink = parsed.rows();
+            }));
+            // Same form with the grid uploaded in the packed format
+            get_validate_input::FormInput packed_input = input;
+            packed_input.pattern_file = get_validate_input::pack_grid(grid);
+            benchmarks.push_back(make_pair("BM_parse_packed", [&] {
+                pattern_grid::Grid parsed;
+                ostringstream discard_errors;
+                get_validate_input::validate_form(packed_input, parsed, patterns, occurrences, convert, discard_errors);
+                benchmark_sink = parsed.rows();
+            }));
+            benchmarks.push_back(make_pair("BM_find_horizontal", [&] {
+                benchmark_sink = pattern_analyzer::find_horizontal_locations(grid, pattern).size();
+            }));
+            benchmarks.push_back(make_pair("BM_find_vertical", [&] {
+                benchmark_sink = pattern_analyzer::find_vertical_locations(grid, pattern).size();
+            }));
+            benchmarks.push_back(make_pair("BM_count_occurrences", [&] {
+                benchmark_sink = pattern_analyzer::count_pattern_occurrences(grid, pattern);
+            }));
+            benchmarks.push_back(make_pair("BM_count_all_directions", [&] {
+                benchmark_sink = pattern_analyzer::count_pattern_occurrences(grid, pattern, pattern_analyzer::ALL_DIRECTIONS);
+            }));
+            // Search answered from a grid index built once outside the timing
+            grid_index::GridIndex index;
+            index.build(grid, result_cache::hash_grid(grid));
+            benchmarks.push_back(make_pair("BM_indexed_analyze", [&] {
+                benchmark_sink = grid_index::analyze_pattern(grid, pattern, index).count;
+            }));
+            // One cell changed per iteration (to 'Z' and back on the next visit), walking the grid; the
+            // analysis is built once outside the timing
+            incremental_analyzer::Analysis editing(grid, pattern);
+            incremental_analyzer::Delta delta;
+            long long edit_number = 0;
+            benchmarks.push_back(make_pair("BM_incremental_edit", [&] {
+                ++edit_number;
+                int r = static_cast<int>(edit_number * 7919 % size);
+                int c = static_cast<int>(edit_number * 104729 % size);
+                editing.apply({{r, c, editing.grid().at(r, c) == 'Z' ? pattern[0] : 'Z'}}, delta);
+                benchmark_sink = editing.count();
+            }));
+            benchmarks.push_back(make_pair("BM_numbered_overlay", [&] {
+                benchmark_sink = pattern_analyzer::number_occurrences(analysis).runs().size();
+            }));
+            benchmarks.push_back(make_pair("BM_pattern_table", [&] {
+                generate_html::generate_pattern_table(discard, grid);
+                discard.flush();
+            }));
+            benchmarks.push_back(make_pair("BM_compact_grid", [&] {
+                generate_html::generate_compact_grid(discard, grid);
+                discard.flush();
+            }));
+            // The numbered grids: the original grid with the overlay laid over it
+            benchmarks.push_back(make_pair("BM_numbered_table", [&] {
+                generate_html::generate_numbered_grid(discard, grid, numbered, false);
+                discard.flush();
+            }));
+            benchmarks.push_back(make_pair("BM_numbered_compact", [&] {
+                generate_html::generate_numbered_grid(discard, grid, numbered, true);
+                discard.flush();
+            }));
+            benchmarks.push_back(make_pair("BM_end_to_end", [&] {
+                request_handler::write_result_page(input, discard);
+                discard.flush();
+            }));
+            // Same page with parsing, searching and writing overlapped (grids under 256 KiB are not pipelined)
+            benchmarks.push_back(make_pair("BM_end_to_end_pipelined", [&] {
+                request_handler::set_pipelined(true);
+                request_handler::write_result_page(input, discard);
+                discard.flush();
+                request_handler::set_pipelined(false);
+            }));
+
+            for (const auto& benchmark : benchmarks) {
+                string name = benchmark.first + suffix;
+                if (!config.filter.empty() && name.find(config.filter) == string::npos) continue;
+                results.push_back(run_benchmark(name, config.min_time, cells, benchmark.second));
+                const BenchmarkResult& r = results.back();
+                snprintf(line, sizeof(line), "%-48s %14.0f %14.0f %12lld\n", r.name.c_str(), r.real_ns, r.cpu_ns, r.iterations);
+                cerr << line;
+            }
+        }
+    }
+
+    if (config.out_file.empty()) {
+        write_json(cout, results);
+    } else {
+        ofstream out(config.out_file.c_str());
+        write_json(out, results);
+        if (!out) {
+            cerr << "Could not write " << config.out_file << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -1,7 +1,24 @@
+g++ -std=c++11 -Wall -c pattern_grid.cpp
 g++ -std=c++11 -Wall -c get_validate_input.cpp
+g++ -std=c++11 -Wall -c html_writer.cpp
 g++ -std=c++11 -Wall -c generate_html.cpp
+g++ -std=c++11 -Wall -O2 -c match_kernel.cpp
+g++ -std=c++11 -Wall -c pattern_automaton.cpp
+g++ -std=c++11 -Wall -pthread -c thread_pool.cpp
 g++ -std=c++11 -Wall -c pattern_analyzer.cpp
+g++ -std=c++11 -Wall -c incremental_analyzer.cpp
+g++ -std=c++11 -Wall -c grid_index.cpp
+g++ -std=c++11 -Wall -c request_metrics.cpp
+g++ -std=c++11 -Wall -c request_arena.cpp
+g++ -std=c++11 -Wall -c result_cache.cpp
+g++ -std=c++11 -Wall -pthread -c request_handler.cpp
 g++ -std=c++11 -Wall -c main.cpp
-g++ -o project3 main.o get_validate_input.o pattern_analyzer.o generate_html.o -lcgicc
+g++ -std=c++11 -Wall -pthread -c server.cpp
+g++ -std=c++11 -Wall -pthread -c batch.cpp
+g++ -std=c++11 -Wall -c pack.cpp
+g++ -pthread -o project3 main.o get_validate_input.o pattern_analyzer.o grid_index.o generate_html.o html_writer.o pattern_grid.o match_kernel.o pattern_automaton.o thread_pool.o request_handler.o result_cache.o request_metrics.o request_arena.o -lcgicc -lz
+g++ -pthread -o project3_server server.o get_validate_input.o pattern_analyzer.o grid_index.o incremental_analyzer.o generate_html.o html_writer.o pattern_grid.o match_kernel.o pattern_automaton.o thread_pool.o request_handler.o result_cache.o request_metrics.o request_arena.o -lcgicc -lz
+g++ -pthread -o project3_batch batch.o get_validate_input.o pattern_analyzer.o grid_index.o pattern_grid.o match_kernel.o pattern_automaton.o thread_pool.o request_metrics.o request_arena.o result_cache.o -lcgicc
+g++ -o project3_pack pack.o get_validate_input.o pattern_grid.o match_kernel.o request_metrics.o -lcgicc
 rm *.o
-chmod 705 project3
\ No newline at end of file
+chmod 705 project3 project3_server project3_batch project3_pack
\ No newline at end of file
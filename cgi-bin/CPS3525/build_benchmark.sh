@@ -0,0 +1,3 @@
+# Builds project3_benchmark (not deployed); run it from this directory, e.g.
+#   ./project3_benchmark --sizes 10,100,1000 --out bench.json
+g++ -std=c++11 -Wall -O2 -pthread -o project3_benchmark benchmark.cpp get_validate_input.cpp pattern_analyzer.cpp incremental_analyzer.cpp grid_index.cpp generate_html.cpp html_writer.cpp pattern_grid.cpp match_kernel.cpp pattern_automaton.cpp thread_pool.cpp request_handler.cpp result_cache.cpp request_metrics.cpp request_arena.cpp -lcgicc -lz
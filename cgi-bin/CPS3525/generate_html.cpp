@@ -4,179 +4,317 @@
 #include <map> // Included for potential future use or compatibility.
 #include <algorithm>
 #include <utility> // For std::pair
+#include <cstring>
 #include "pattern_analyzer.h"
+#include "html_writer.h"
 #include "generate_html.h" // Assuming this header declares the generate_html class and its functions
 
 using namespace std;
 
-// Function to generate the basic HTML header for the response page
-string generate_html::generate_html_header(const string& title) {
-    return "<!DOCTYPE html>\n"
-           "<html lang=\"en\">\n"
-           "<head>\n"
-           "    <meta charset=\"UTF-8\">\n"
-           "    <meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n"
-           "    <title>" + title + "</title>\n"
-           "    <style>\n"
-           "        body { font-family: sans-serif; margin: 20px; background-color: #f4f4f4; }\n"
-           "        .container { background-color: #fff; padding: 20px; border-radius: 8px; box-shadow: 0 0 10px rgba(0, 0, 0, 0.1); }\n"
-           "        h2, h3 { color: #333; text-align: center; }\n"
-           "        p { color: #555; margin-bottom: 10px; }\n"
-           "        pre, .pattern-table { background-color: #eee; padding: 10px; border-radius: 4px; overflow-x: auto; }\n"
-           "        .pattern-table { border-collapse: collapse; margin-bottom: 15px; }\n"
-           "        .pattern-table td { border: 1px solid #ccc; padding: 5px; text-align: center; min-width: 20px; }\n"
-           "        .correct { color: green; font-weight: bold; }\n" // Style for correct guess message
-           "        .incorrect { color: red; font-weight: bold; }\n" // Style for incorrect guess message
-           "    </style>\n"
-           "</head>\n"
-           "<body>\n"
-           "    <div class=\"container\">\n";
-}
-
-// Function to generate the basic HTML footer to close the document structure
-string generate_html::generate_html_footer() {
-    return "    </div>\n"
-           "</body>\n"
-           "</html>";
-}
-
-// Function to generate an HTML heading tag (h2 or h3)
-string generate_html::generate_heading(const string& text, int level) {
-    if (level == 2) return "<h2>" + text + "</h2>\n";
-    if (level == 3) return "<h3>" + text + "</h3>\n";
-    return "<h2>" + text + "</h2>\n"; // Default to h2 if level is not 2 or 3
-}
-
-// Function to generate an HTML paragraph tag
-string generate_html::generate_paragraph(const string& text) {
-    return "<p>" + text + "</p>\n";
-}
-
-// Function to generate the 2D pattern grid as an HTML table for display
-string generate_html::generate_pattern_table(const vector<string>& pattern) {
+// Function to write the basic HTML header for the response page
+void generate_html::generate_html_header(html_writer::Writer& out, const string& title) {
+    out.raw("<!DOCTYPE html>\n"
+            "<html lang=\"en\">\n"
+            "<head>\n"
+            "    <meta charset=\"UTF-8\">\n"
+            "    <meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n"
+            "    <title>");
+    out.text(title);
+    out.raw("</title>\n"
+            "    <style>\n"
+            "        body { font-family: sans-serif; margin: 20px; background-color: #f4f4f4; }\n"
+            "        .container { background-color: #fff; padding: 20px; border-radius: 8px; box-shadow: 0 0 10px rgba(0, 0, 0, 0.1); }\n"
+            "        h2, h3 { color: #333; text-align: center; }\n"
+            "        p { color: #555; margin-bottom: 10px; }\n"
+            "        pre, .pattern-table { background-color: #eee; padding: 10px; border-radius: 4px; overflow-x: auto; }\n"
+            "        .pattern-table { border-collapse: collapse; margin-bottom: 15px; }\n"
+            "        .pattern-table td, .pattern-table th { border: 1px solid #ccc; padding: 5px; text-align: center; min-width: 20px; }\n"
+            "        .pattern-grid { line-height: 1.2; }\n" // Compact layout: one line of text per row
+            "        .pattern-grid mark { background-color: #ffe08a; }\n" // Cells of accepted occurrences
+            "        .correct { color: green; font-weight: bold; }\n" // Style for correct guess message
+            "        .incorrect { color: red; font-weight: bold; }\n" // Style for incorrect guess message
+            "    </style>\n"
+            "</head>\n"
+            "<body>\n"
+            "    <div class=\"container\">\n");
+}
+
+// Function to write the basic HTML footer to close the document structure
+void generate_html::generate_html_footer(html_writer::Writer& out) {
+    out.raw("    </div>\n"
+            "</body>\n"
+            "</html>");
+}
+
+// Function to write an HTML heading tag (h2 or h3); text may contain markup
+void generate_html::generate_heading(html_writer::Writer& out, const string& text, int level) {
+    const char* tag = (level == 3) ? "h3" : "h2"; // Default to h2 if level is not 2 or 3
+    out.raw("<");
+    out.raw(tag);
+    out.raw(">");
+    out.raw(text);
+    out.raw("</");
+    out.raw(tag);
+    out.raw(">\n");
+}
+
+// Function to write an HTML paragraph tag; text may contain markup
+void generate_html::generate_paragraph(html_writer::Writer& out, const string& text) {
+    out.raw("<p>");
+    out.raw(text);
+    out.raw("</p>\n");
+}
+
+// Opening tag of a grid in the table layout or, with compact, the compact layout
+void generate_html::begin_grid(html_writer::Writer& out, bool compact) {
+    out.raw(compact ? "<pre class=\"pattern-grid\">" : "<table class=\"pattern-table\">\n"); // Removed paragraph tag here, will add label in main
+}
+
+void generate_html::end_grid(html_writer::Writer& out, bool compact) {
+    out.raw(compact ? "</pre>\n" : "</table>\n");
+}
+
+// Writes rows [first_row, last_row) of a grid opened with begin_grid, so a grid can be written a
+// band at a time. In the table layout each character gets its own cell; cells go straight into the
+// writer's buffer and no per-cell strings are built. In the compact layout each row is one line.
+void generate_html::generate_grid_rows(html_writer::Writer& out, const pattern_grid::Grid& pattern, int first_row, int last_row,
+                                       bool compact) {
+    for (int r = first_row; r < last_row; ++r) {
+        const char* row = pattern.row(r);
+        if (!compact) {
+            out.raw("<tr>\n", 5);
+            for (int c = 0; c < pattern.cols(); ++c) {
+                out.raw("<td>", 4);    // Each character in its own table cell
+                out.text(row[c]);
+                out.raw("</td>\n", 6);
+            }
+            out.raw("</tr>\n", 6);
+        } else {
+            out.text(row, pattern.cols());
+            out.raw("\n", 1);
+        }
+    }
+}
+
+// Function to write the 2D pattern grid as an HTML table for display.
+void generate_html::generate_pattern_table(html_writer::Writer& out, const pattern_grid::Grid& pattern) {
     if (pattern.empty()) {
-        return "<p>No pattern grid to display.</p>\n"; // Updated text
+        out.raw("<p>No pattern grid to display.</p>\n"); // Updated text
+        return;
     }
-    string table = "<table class=\"pattern-table\">\n"; // Removed paragraph tag here, will add label in main
-    for (const auto& row : pattern) {
-        table += "<tr>\n";
-        for (char c : row) {
-            table += "<td>" + string(1, c) + "</td>\n";    // Each character in its own table cell
-        }
-        table += "</tr>\n";
+    begin_grid(out, false);
+    generate_grid_rows(out, pattern, 0, pattern.rows(), false);
+    end_grid(out, false);
+}
+
+// Function to write the 2D pattern grid in the compact layout: one line of a <pre> per row instead
+// of one table cell per character.
+void generate_html::generate_compact_grid(html_writer::Writer& out, const pattern_grid::Grid& pattern) {
+    if (pattern.empty()) {
+        out.raw("<p>No pattern grid to display.</p>\n");
+        return;
     }
-    table += "</table>\n";
-    return table;
+    begin_grid(out, true);
+    generate_grid_rows(out, pattern, 0, pattern.rows(), true);
+    end_grid(out, true);
 }
 
 // Removed generate_character_counts function as it's not needed for the core word search result display
 
-// Function to generate the result message for the word search game
-// This function compares the guessed occurrence count with the actual count and generates corresponding HTML
-string generate_html::generate_result_message(bool correct, const string& guessed_pattern, int guessed_occurrence, int actual_occurrence_count) {
-    string message;
-
+// Function to write the result message for the word search game
+// This function compares the guessed occurrence count with the actual count and writes corresponding HTML
+void generate_html::generate_result_message(html_writer::Writer& out, bool correct, const string& guessed_pattern, int guessed_occurrence, int actual_occurrence_count) {
     // Display the user's guess for the pattern and its occurrences
-    message += generate_paragraph("Your guess: " + to_string(guessed_occurrence) + " occurrences of \"" + guessed_pattern + "\"");
+    out.raw("<p>Your guess: ");
+    out.number(guessed_occurrence);
+    out.raw(" occurrences of \"");
+    out.text(guessed_pattern);
+    out.raw("\"</p>\n");
 
     // Display the actual count of the pattern found in the grid
-    message += generate_paragraph("Actual occurrences found: " + to_string(actual_occurrence_count));
+    out.raw("<p>Actual occurrences found: ");
+    out.number(actual_occurrence_count);
+    out.raw("</p>\n");
 
-    // Generate the final result message based on whether the guess was correct
+    // Write the final result message based on whether the guess was correct
     if (correct) {
-        message += generate_heading("Congratulations! Your guess is correct.", 3);
-        message += generate_paragraph("<span class=\"correct\">The pattern \"" + guessed_pattern + "\" was found exactly " + to_string(actual_occurrence_count) + " times.</span>");
+        generate_heading(out, "Congratulations! Your guess is correct.", 3);
+        out.raw("<p><span class=\"correct\">The pattern \"");
+        out.text(guessed_pattern);
+        out.raw("\" was found exactly ");
+        out.number(actual_occurrence_count);
+        out.raw(" times.</span></p>\n");
     } else {
-        message += generate_heading("Sorry, your guess is incorrect.", 3);
-        message += generate_paragraph("<span class=\"incorrect\">You guessed " + to_string(guessed_occurrence) + " occurrences, but the pattern \"" + guessed_pattern + "\" was found " + to_string(actual_occurrence_count) + " times.</span>");
+        generate_heading(out, "Sorry, your guess is incorrect.", 3);
+        out.raw("<p><span class=\"incorrect\">You guessed ");
+        out.number(guessed_occurrence);
+        out.raw(" occurrences, but the pattern \"");
+        out.text(guessed_pattern);
+        out.raw("\" was found ");
+        out.number(actual_occurrence_count);
+        out.raw(" times.</span></p>\n");
     }
-
-    return message;
 }
 
 
 
-// Generates a grid with overlapping and non-sharing pattern occurrences replaced by numbers
-vector<string> pattern_analyzer::generate_numbered_grid(const vector<string>& grid, const string& pattern) {
-    vector<string> numbered_grid = grid; // Create a copy of the original grid
-
-    if (pattern.empty() || grid.empty() || grid[0].empty()) {
-        return numbered_grid; // Return original grid if pattern or grid is invalid
+// Function to write the results for a list of guessed patterns as one HTML table,
+// one row per pattern with the guess, the actual count and whether the guess was right
+void generate_html::generate_results_table(html_writer::Writer& out, const vector<string>& guessed_patterns, const vector<int>& guessed_occurrences, const vector<int>& actual_occurrence_counts) {
+    out.raw("<table class=\"pattern-table results-table\">\n");
+    out.raw("<tr>\n<th>Pattern</th>\n<th>Your guess</th>\n<th>Actual occurrences</th>\n<th>Result</th>\n</tr>\n");
+    int correct_count = 0;
+    for (size_t i = 0; i < guessed_patterns.size(); ++i) {
+        bool correct = (guessed_occurrences[i] == actual_occurrence_counts[i]);
+        if (correct) correct_count++;
+        out.raw("<tr>\n<td>");
+        out.text(guessed_patterns[i]);
+        out.raw("</td>\n<td>");
+        out.number(guessed_occurrences[i]);
+        out.raw("</td>\n<td>");
+        out.number(actual_occurrence_counts[i]);
+        out.raw("</td>\n");
+        out.raw(correct ? "<td><span class=\"correct\">Correct</span></td>\n" : "<td><span class=\"incorrect\">Incorrect</span></td>\n");
+        out.raw("</tr>\n");
     }
+    out.raw("</table>\n<p>");
+    out.number(correct_count);
+    out.raw(" of ");
+    out.number(guessed_patterns.size());
+    out.raw(" guesses correct.</p>\n");
+}
 
-    int rows = grid.size();
-    int cols = grid[0].size();
-    int pattern_len = pattern.length();
-
-    if (pattern_len == 0) return numbered_grid;
+// Adds the cells of loc on rows [first_row, last_row): a horizontal occurrence (either way) as one
+// run from its leftmost cell, any other direction as one run per cell
+void pattern_analyzer::NumberedOverlay::add(const PatternLocation& loc, int occurrence, int first_row, int last_row) {
+    int row_step = 0, col_step = 1;
+    direction_step(loc.direction, row_step, col_step);
+    if (row_step == 0) {
+        if (loc.row >= first_row && loc.row < last_row) {
+            int col = (col_step < 0) ? loc.col - (loc.length - 1) : loc.col;
+            OverlayRun run = {loc.row, col, loc.length, occurrence};
+            if (!runs_.empty() && !reading_order(runs_.back(), run)) {
+                sorted_ = false;
+            }
+            runs_.push_back(run);
+        }
+        return;
+    }
+    for (int i = 0; i < loc.length; ++i) {
+        int r = loc.row + i * row_step;
+        if (r >= first_row && r < last_row) {
+            crossing_.push_back({r, loc.col + i * col_step, 1, occurrence});
+        }
+    }
+}
 
-    // Call helper functions to find ALL overlapping locations
-    vector<PatternLocation> h_locations = pattern_analyzer::find_horizontal_locations(grid, pattern);
-    vector<PatternLocation> v_locations = pattern_analyzer::find_vertical_locations(grid, pattern);
+bool pattern_analyzer::NumberedOverlay::reading_order(const OverlayRun& a, const OverlayRun& b) {
+    return (a.row != b.row) ? a.row < b.row : a.col < b.col;
+}
 
-    vector<PatternLocation> all_locations;
-    all_locations.insert(all_locations.end(), h_locations.begin(), h_locations.end());
-    all_locations.insert(all_locations.end(), v_locations.begin(), v_locations.end());
+// Horizontal occurrences added in reading order leave their runs in order, so usually only the
+// cells of the other directions are sorted and then merged in. Accepted occurrences never share
+// cells, so no two runs start on the same cell.
+void pattern_analyzer::NumberedOverlay::sort() {
+    if (!sorted_) {
+        std::sort(runs_.begin(), runs_.end(), reading_order);
+        sorted_ = true;
+    }
+    if (!crossing_.empty()) {
+        std::sort(crossing_.begin(), crossing_.end(), reading_order);
+        size_t middle = runs_.size();
+        runs_.insert(runs_.end(), crossing_.begin(), crossing_.end());
+        inplace_merge(runs_.begin(), runs_.begin() + middle, runs_.end(), reading_order);
+        crossing_.clear();
+    }
+}
 
-    // Sort locations to process them in a consistent order (reading order)
-    sort(all_locations.begin(), all_locations.end());
+// Builds the numbered view from an existing analysis, so the search is not repeated
+pattern_analyzer::NumberedOverlay pattern_analyzer::number_occurrences(const AnalysisResult& result) {
+    NumberedOverlay overlay;
+    // The accepted locations are already in reading order, which is the numbering order
+    for (size_t i = 0; i < result.locations.size(); ++i) {
+        overlay.add(result.locations[i], static_cast<int>(i + 1));
+    }
+    overlay.sort();
+    return overlay;
+}
 
-    // Use a boolean grid to track occupied cells
-    vector<vector<bool>> occupied(rows, vector<bool>(cols, false));
-    int occurrence_counter = 1;
+// Writes the decimal digits of a positive number to out; returns how many
+static size_t format_number(char* out, int value) {
+    char digits[12];
+    size_t n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    reverse_copy(digits, digits + n, out);
+    return n;
+}
 
-    for (const auto& loc : all_locations) {
-        bool can_occupy = true;
-        // Check if the cells for this occurrence are already occupied
-        if (loc.direction == 'H') {
-            for (int i = 0; i < loc.length; ++i) {
-                 if (loc.col + i < cols && occupied[loc.row][loc.col + i]) {
-                    can_occupy = false;
-                    break;
-                }
-            }
-        } else { // direction == 'V'
-            for (int i = 0; i < loc.length; ++i) {
-                if (loc.row + i < rows && occupied[loc.row + i][loc.col]) {
-                    can_occupy = false;
-                    break;
-                }
-            }
+// Writes rows [first_row, last_row) of a grid opened with begin_grid with the occurrence numbers of
+// overlay (sorted) laid over it. next_run is the first run not yet written and is moved past the rows
+// written, so the grid can be written a band at a time. In the table layout each covered cell shows
+// the full number of its occurrence; in the compact layout the letters stay, so the columns keep
+// lining up, and each run is wrapped in a <mark> whose title is the number.
+void generate_html::generate_numbered_rows(html_writer::Writer& out, const pattern_grid::Grid& pattern, int first_row, int last_row,
+                                           bool compact, const pattern_analyzer::NumberedOverlay& overlay, size_t& next_run) {
+    const vector<pattern_analyzer::OverlayRun>& runs = overlay.runs();
+    int cols = pattern.cols();
+    for (int r = first_row; r < last_row; ++r) {
+        while (next_run < runs.size() && runs[next_run].row < r) {
+            ++next_run; // Runs on rows before first_row
         }
-
-        // If no cells are occupied, this is a valid occurrence (not sharing characters with previously processed valid matches)
-        if (can_occupy) {
-            // Determine the replacement character based on the occurrence counter
-            char rep_char;
-            if (occurrence_counter > 0 && occurrence_counter <= 9) {
-                rep_char = '0' + occurrence_counter;
+        const char* row = pattern.row(r);
+        if (!compact) out.raw("<tr>\n", 5);
+        int c = 0;
+        while (c < cols) {
+            bool covered = next_run < runs.size() && runs[next_run].row == r;
+            int plain_end = covered ? min(runs[next_run].col, cols) : cols;
+            if (compact) {
+                out.text(row + c, plain_end - c);
             } else {
-                // If more than 9 occurances, simply resents back to one
-                occurrence_counter = 1;
-                rep_char = '0' + occurrence_counter;
+                for (; c < plain_end; ++c) {
+                    out.raw("<td>", 4);
+                    out.text(row[c]);
+                    out.raw("</td>\n", 6);
+                }
             }
+            c = plain_end;
+            if (!covered) break;
 
-            // Perform the replacement in the numbered_grid copy and mark cells as occupied
-            if (loc.direction == 'H') {
-                for (int i = 0; i < loc.length; ++i) {
-                     if (loc.col + i < cols) { // Ensure bounds are checked
-                        numbered_grid[loc.row][loc.col + i] = rep_char;
-                        occupied[loc.row][loc.col + i] = true;
-                     }
-                }
-            } else { // direction == 'V'
-                for (int i = 0; i < loc.length; ++i) {
-                    if (loc.row + i < rows) { // Ensure bounds are checked
-                        numbered_grid[loc.row + i][loc.col] = rep_char;
-                        occupied[loc.row + i][loc.col] = true;
-                    }
+            const pattern_analyzer::OverlayRun& run = runs[next_run++];
+            int end = min(run.col + run.length, cols);
+            if (compact) {
+                out.raw("<mark title=\"", 13);
+                out.number(run.occurrence);
+                out.raw("\">", 2);
+                out.text(row + c, end - c);
+                out.raw("</mark>", 7);
+            } else {
+                // The cell is the same for the whole run, so it is formatted once
+                char cell[32] = "<td>";
+                size_t cell_length = 4 + format_number(cell + 4, run.occurrence);
+                memcpy(cell + cell_length, "</td>\n", 6);
+                cell_length += 6;
+                for (int k = c; k < end; ++k) {
+                    out.raw(cell, cell_length);
                 }
             }
-
-            occurrence_counter++; // Move to the next occurrence number
+            c = max(c, end);
         }
+        out.raw(compact ? "\n" : "</tr>\n");
     }
-
-    return numbered_grid; // Return the grid with numbered occurrences
 }
 
+// Function to write the 2D pattern grid with the occurrences in overlay numbered, in either layout
+void generate_html::generate_numbered_grid(html_writer::Writer& out, const pattern_grid::Grid& pattern, const pattern_analyzer::NumberedOverlay& overlay, bool compact) {
+    if (pattern.empty()) {
+        out.raw("<p>No pattern grid to display.</p>\n");
+        return;
+    }
+    size_t next_run = 0;
+    begin_grid(out, compact);
+    generate_numbered_rows(out, pattern, 0, pattern.rows(), compact, overlay, next_run);
+    end_grid(out, compact);
+}
@@ -7,17 +7,26 @@
 #include <map>
 #include <algorithm>
 #include <utility>
+#include "pattern_grid.h"
+#include "html_writer.h"
+#include "pattern_analyzer.h"
 
 using namespace std;
 
 namespace generate_html {
-	string generate_html_header(const string& title);;
-	string generate_html_footer();
-	string generate_heading(const string& text, int level);
-	string generate_paragraph(const string& text);
-	string generate_pattern_table(const vector<string>& pattern);
-	vector<string> generate_numbered_grid(const vector<string>& grid, const string& pattern);
-	string generate_result_message(bool correct, const string& guessed_pattern, int guessed_occurrence, int actual_occurrence_count);
+	void generate_html_header(html_writer::Writer& out, const string& title);
+	void generate_html_footer(html_writer::Writer& out);
+	void generate_heading(html_writer::Writer& out, const string& text, int level);
+	void generate_paragraph(html_writer::Writer& out, const string& text);
+	void begin_grid(html_writer::Writer& out, bool compact);
+	void generate_grid_rows(html_writer::Writer& out, const pattern_grid::Grid& pattern, int first_row, int last_row, bool compact);
+	void end_grid(html_writer::Writer& out, bool compact);
+	void generate_pattern_table(html_writer::Writer& out, const pattern_grid::Grid& pattern);
+	void generate_compact_grid(html_writer::Writer& out, const pattern_grid::Grid& pattern);
+	void generate_numbered_rows(html_writer::Writer& out, const pattern_grid::Grid& pattern, int first_row, int last_row, bool compact, const pattern_analyzer::NumberedOverlay& overlay, size_t& next_run);
+	void generate_numbered_grid(html_writer::Writer& out, const pattern_grid::Grid& pattern, const pattern_analyzer::NumberedOverlay& overlay, bool compact);
+	void generate_result_message(html_writer::Writer& out, bool correct, const string& guessed_pattern, int guessed_occurrence, int actual_occurrence_count);
+	void generate_results_table(html_writer::Writer& out, const vector<string>& guessed_patterns, const vector<int>& guessed_occurrences, const vector<int>& actual_occurrence_counts);
 }
 
 #endif 
@@ -3,6 +3,18 @@
 #include <vector>
 #include <sstream>
 #include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "cgicc/Cgicc.h"
 #include "cgicc/HTTPHTMLHeader.h"
@@ -10,6 +22,8 @@
 #include "cgicc/FormFile.h"
 
 #include "get_validate_input.h"
+#include "match_kernel.h"
+#include "request_metrics.h"
 
 using namespace std;
 using namespace cgicc;
@@ -30,133 +44,530 @@ bool get_validate_input::is_uppercase(const string& str) {
     if (str.empty()) {
         return false;
     }
-    for (char c : str) {
-        if (c < 'A' || c > 'Z') {
-            return false;
+    return match_kernel::all_uppercase(str.data(), str.size());
+}
+
+// Returns true for the bytes trim() strips
+static inline bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static const char PACKED_MAGIC[4] = {'P', '3', 'G', '5'};
+
+static uint32_t load_le32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint64_t load_le64(const unsigned char* p) {
+    return load_le32(p) | (static_cast<uint64_t>(load_le32(p + 4)) << 32);
+}
+
+static void append_le(string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out += static_cast<char>(value >> (8 * i));
+    }
+}
+
+// The packed format's checksum is taken a block at a time, so the parser can check each block
+// just before unpacking it, while it is still in cache
+static const size_t PACKED_CHECKSUM_BLOCK = 64u << 10;
+
+// Adds packed[from, to) to checksum; from is on a block boundary, to on one or at the end
+static uint64_t hash_packed_blocks(const unsigned char* packed, size_t from, size_t to, uint64_t checksum) {
+    for (size_t block = from; block < to; block += PACKED_CHECKSUM_BLOCK) {
+        checksum = match_kernel::checksum(packed + block, min(PACKED_CHECKSUM_BLOCK, to - block), checksum);
+    }
+    return checksum;
+}
+
+// Writes the header, then every cell's code into a 64-bit accumulator that is emptied a byte at a time
+string get_validate_input::pack_grid(const pattern_grid::Grid& grid) {
+    string cells;
+    cells.reserve((static_cast<size_t>(grid.rows()) * grid.cols() * 5 + 7) / 8);
+    uint64_t bits = 0;
+    int bit_count = 0;
+    for (int r = 0; r < grid.rows(); ++r) {
+        const char* row = grid.row(r);
+        for (int c = 0; c < grid.cols(); ++c) {
+            bits |= static_cast<uint64_t>((row[c] - 'A') & 31) << bit_count;
+            bit_count += 5;
+            for (; bit_count >= 8; bit_count -= 8, bits >>= 8) {
+                cells += static_cast<char>(bits & 0xFF);
+            }
         }
     }
+    if (bit_count > 0) {
+        cells += static_cast<char>(bits & 0xFF);
+    }
+
+    string packed(PACKED_MAGIC, sizeof(PACKED_MAGIC));
+    append_le(packed, grid.rows(), 4);
+    append_le(packed, grid.cols(), 4);
+    append_le(packed, hash_packed_blocks(reinterpret_cast<const unsigned char*>(cells.data()), 0, cells.size(), 0), 8);
+    return packed + cells;
+}
+
+get_validate_input::GridParser::GridParser()
+    : grid_(nullptr), next_(nullptr), end_(nullptr), rows_(0), cols_(0), rows_read_(0),
+      packed_(nullptr), packed_bytes_(0), hashed_bytes_(0), checksum_(0), expected_checksum_(0) {}
+
+// Reads the "rows cols" line and allocates the whole grid from it
+bool get_validate_input::GridParser::begin(const char* data, size_t length, pattern_grid::Grid& pattern_grid_content, ostream& out) {
+    if (length >= PACKED_HEADER_BYTES && memcmp(data, PACKED_MAGIC, sizeof(PACKED_MAGIC)) == 0) {
+        return begin_packed(data, length, pattern_grid_content, out);
+    }
+    packed_ = nullptr;
+    const char* end = data + length;
+    const char* newline = static_cast<const char*>(memchr(data, '\n', length));
+    const char* header_end = newline ? newline : end;
+    string header(data, header_end); // Only the first line is copied
+
+    size_t rows = 0;
+    size_t cols = 0;
+
+    // Read the first line which should contain the dimensions (rows and columns)
+    stringstream ss_dims(header);
+    if (!(ss_dims >> rows >> cols) || rows == 0 || cols == 0 || rows > INT_MAX || cols > INT_MAX) {
+        out << "Error: Could not parse valid positive rows and columns from the first line of the file: '" << header << "'" << endl;
+        return false;
+    }
+
+    // Every cell needs at least one byte of the upload, so larger dimensions cannot be valid
+    if (rows > length / cols) {
+        out << "Error: Dimensions " << rows << " x " << cols << " from the first line do not fit in the uploaded file." << endl;
+        return false;
+    }
+
+    pattern_grid_content = pattern_grid::Grid(rows, cols); // Allocate the whole grid up front
+    grid_ = &pattern_grid_content;
+    next_ = newline ? newline + 1 : end;
+    end_ = end;
+    rows_ = rows;
+    cols_ = cols;
+    rows_read_ = 0;
     return true;
 }
 
-// Extracts and validates form data including the uploaded pattern file,
-// the guessed pattern string, the guessed occurrences count, and the convert option.
-// Variable names aligned with HTML form field names where appropriate.
-bool get_validate_input::get_form_data(vector<string>& pattern_grid_content, string& guessed_pattern, int& guessed_occurrences, bool& convertToNumber) {
-    try {
-        Cgicc cgi; // Create CGI object to access form data
+// Checks the packed header against the upload's size; the checksum is checked as the rows are unpacked
+bool get_validate_input::GridParser::begin_packed(const char* data, size_t length, pattern_grid::Grid& pattern_grid_content, ostream& out) {
+    const unsigned char* header = reinterpret_cast<const unsigned char*>(data);
+    size_t rows = load_le32(header + 4);
+    size_t cols = load_le32(header + 8);
+    size_t packed_bytes = length - PACKED_HEADER_BYTES;
+    if (rows == 0 || cols == 0 || rows > INT_MAX || cols > INT_MAX) {
+        out << "Error: Could not read valid positive rows and columns from the packed grid header: "
+            << rows << " x " << cols << "." << endl;
+        return false;
+    }
+    // Checked against the size first, so the number of cells cannot overflow below
+    if (rows > packed_bytes * 8 / 5 / cols || (rows * cols * 5 + 7) / 8 != packed_bytes) {
+        out << "Error: Dimensions " << rows << " x " << cols << " from the packed grid header do not match the "
+            << packed_bytes << " bytes of cells in the uploaded file." << endl;
+        return false;
+    }
 
-        // Retrieve the "guess_pattern" field from the form
-        const_form_iterator guess_pattern_iter = cgi.getElement("guess_pattern");
-        if (guess_pattern_iter == cgi.getElements().end() || guess_pattern_iter->getValue().empty()) {
-            cout << "Error: Form field 'guess_pattern' not found or empty." << endl;
+    pattern_grid_content = pattern_grid::Grid(rows, cols);
+    grid_ = &pattern_grid_content;
+    next_ = end_ = data + length; // No lines follow for finish() to check
+    rows_ = rows;
+    cols_ = cols;
+    rows_read_ = 0;
+    packed_ = header + PACKED_HEADER_BYTES;
+    packed_bytes_ = packed_bytes;
+    hashed_bytes_ = 0;
+    checksum_ = 0;
+    expected_checksum_ = load_le64(header + 12);
+    return true;
+}
+
+// Adds the blocks that hold packed[0, bytes) to the checksum, if they are not in it yet
+void get_validate_input::GridParser::hash_packed_through(size_t bytes) {
+    if (bytes <= hashed_bytes_) {
+        return;
+    }
+    size_t to = min(packed_bytes_, (bytes + PACKED_CHECKSUM_BLOCK - 1) / PACKED_CHECKSUM_BLOCK * PACKED_CHECKSUM_BLOCK);
+    checksum_ = hash_packed_blocks(packed_, hashed_bytes_, to, checksum_);
+    hashed_bytes_ = to;
+}
+
+// Finds the next line that is not blank and trims it; false at the end of the upload
+bool get_validate_input::GridParser::next_line(const char*& first, const char*& last) {
+    while (next_ < end_) {
+        const char* line_end = static_cast<const char*>(memchr(next_, '\n', end_ - next_));
+        if (line_end == nullptr) {
+            line_end = end_;
+        }
+        first = next_;
+        last = line_end;
+        next_ = line_end + 1;
+        while (first < last && is_space(*first)) ++first;
+        while (last > first && is_space(last[-1])) --last;
+        if (last != first) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Each line must have the correct number of columns and be uppercase
+bool get_validate_input::GridParser::valid_line(const char* first, const char* last, ostream& out) const {
+    if (static_cast<size_t>(last - first) == cols_ && match_kernel::all_uppercase(first, cols_)) {
+        return true;
+    }
+    out << "Error: Invalid pattern line format or content found. Line: '" << string(first, last) << "'. Expected " << cols_ << " uppercase characters." << endl;
+    return false;
+}
+
+bool get_validate_input::GridParser::parse_rows(size_t max_rows, ostream& out) {
+    size_t target = rows_read_ + min(max_rows, rows_ - rows_read_);
+    if (packed_ != nullptr) {
+        for (; rows_read_ < target; ++rows_read_) {
+            hash_packed_through(((rows_read_ + 1) * cols_ * 5 + 7) / 8);
+            if (!match_kernel::unpack_letters(packed_, packed_bytes_, rows_read_ * cols_, cols_, grid_->row(rows_read_))) {
+                out << "Error: Packed grid row " << rows_read_ + 1 << " holds a code that is not a letter A-Z." << endl;
+                return false;
+            }
+        }
+        return true;
+    }
+    const char* first;
+    const char* last;
+    while (rows_read_ < target && next_line(first, last)) {
+        if (!valid_line(first, last, out)) {
             return false;
         }
-        guessed_pattern = guess_pattern_iter->getValue(); // Assign value to the updated variable name
+        grid_->set_row(rows_read_++, first); // Store line in the grid
+    }
+    return true;
+}
 
-        // Validate the guessed pattern string (e.g., check if it's empty or contains invalid characters)
-        // Assuming only uppercase letters are allowed in the pattern string based on previous logic.
-        if (guessed_pattern.empty() || !is_uppercase(guessed_pattern)) { // Assuming is_uppercase can handle strings > 1 char
-            cout << "Error: Invalid guess pattern submitted: '" << guessed_pattern << "'. Expected one or more uppercase letters." << endl;
+// Lines after the last row are still validated and counted, so extra rows are reported
+bool get_validate_input::GridParser::finish(ostream& out) {
+    if (packed_ != nullptr) {
+        hash_packed_through(packed_bytes_);
+        if (checksum_ != expected_checksum_) {
+            out << "Error: The packed grid's checksum does not match its cells; the file is damaged." << endl;
+            return false;
+        }
+    }
+    size_t actual_rows_read = rows_read_;
+    const char* first;
+    const char* last;
+    while (next_line(first, last)) {
+        if (!valid_line(first, last, out)) {
             return false;
         }
+        actual_rows_read++;
+    }
+     // Ensure the number of valid rows read matches the expected number
+    if (actual_rows_read != rows_) {
+        out << "Error: Number of valid pattern rows read (" << actual_rows_read
+             << ") does not match the expected number of rows (" << rows_
+             << ") specified in the first line." << endl;
+        return false;
+    }
+    return true;
+}
 
+// Parses a grid file ("rows cols" on the first line, then one line of uppercase letters per row, or
+// the packed format) straight out of data[0, length). Lines are found with memchr, trimmed by moving pointers,
+// validated in place and copied once, into a grid allocated from the header's dimensions.
+bool get_validate_input::parse_grid(const char* data, size_t length, pattern_grid::Grid& pattern_grid_content, ostream& out) {
+    GridParser parser;
+    return parser.begin(data, length, pattern_grid_content, out) &&
+           parser.parse_rows(SIZE_MAX, out) &&
+           parser.finish(out);
+}
 
-        // Retrieve the "guess_occurrences" field from the form
-        const_form_iterator guess_occurrences_iter = cgi.getElement("guess_occurrences");
-        if (guess_occurrences_iter == cgi.getElements().end() || guess_occurrences_iter->getValue().empty()) {
-            cout << "Error: Form field 'guess_occurrences' not found or empty." << endl;
+// Builds a view over data[0, length) when the rows sit one per line right after the header, each
+// exactly cols letters followed by "\n" or "\r\n", with only whitespace after the last row. The
+// line terminator then becomes the grid's stride padding and no cell is copied.
+// Returns false for any other layout; parse_grid handles (and reports on) those.
+static bool view_grid(const shared_ptr<const char>& storage, size_t length, pattern_grid::Grid& pattern_grid_content) {
+    const char* data = storage.get();
+    const char* end = data + length;
+    const char* newline = static_cast<const char*>(memchr(data, '\n', length));
+    if (newline == nullptr) {
+        return false;
+    }
+    size_t rows = 0;
+    size_t cols = 0;
+    stringstream ss_dims(string(data, newline));
+    if (!(ss_dims >> rows >> cols) || rows == 0 || cols == 0 || rows > length / cols || rows > INT_MAX || cols > INT_MAX) {
+        return false;
+    }
+
+    const char* first = newline + 1;
+    size_t available = end - first;
+    if (available < cols) {
+        return false;
+    }
+    size_t stride = (available > cols + 1 && first[cols] == '\r' && first[cols + 1] == '\n') ? cols + 2 : cols + 1;
+    if (rows - 1 > (available - cols) / stride) {
+        return false; // The last row would run past the end of the file
+    }
+    for (size_t r = 0; r < rows; ++r) {
+        const char* row = first + r * stride;
+        if (!match_kernel::all_uppercase(row, cols)) {
+            return false;
+        }
+        const char* terminator = row + cols;
+        size_t remaining = end - terminator;
+        bool terminated = stride == cols + 1 ? (remaining >= 1 && terminator[0] == '\n')
+                                             : (remaining >= 2 && terminator[0] == '\r' && terminator[1] == '\n');
+        if (!terminated && r + 1 < rows) {
+            return false;
+        }
+    }
+    for (const char* rest = min(first + (rows - 1) * stride + cols, end); rest < end; ++rest) {
+        if (!is_space(*rest)) {
             return false;
         }
-        string occurrence_str = guess_occurrences_iter->getValue(); // Get string value from the field
+    }
+    pattern_grid_content = pattern_grid::Grid(storage, first, rows, cols, stride);
+    return true;
+}
 
-        // Convert the string value to an integer and validate
-        try {
-            size_t processed_chars;
-            guessed_occurrences = stoi(occurrence_str, &processed_chars); // Convert and assign to updated variable name
+// Loads a grid file by mapping it into memory. A file in the plain one-row-per-line layout
+// becomes a view over the mapping, so the cells are never copied and peak memory stays at
+// about the file size; other layouts go through parse_grid straight from the mapping.
+bool get_validate_input::load_grid_file(const string& path, pattern_grid::Grid& pattern_grid_content, ostream& out) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        out << "Error: Could not open the file '" << path << "': " << strerror(errno) << endl;
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    size_t length = info.st_size;
+    if (length == 0) {
+        close(fd);
+        out << "Error: The file '" << path << "' is empty." << endl;
+        return false;
+    }
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping stays valid without the descriptor
+    if (mapped == MAP_FAILED) {
+        out << "Error: Could not map the file '" << path << "': " << strerror(errno) << endl;
+        return false;
+    }
+    madvise(mapped, length, MADV_SEQUENTIAL); // Rows are validated, then scanned, front to back
+    shared_ptr<const char> storage(static_cast<const char*>(mapped), [length](const char* p) {
+        munmap(const_cast<char*>(p), length);
+    });
 
-            // Check if the entire string was consumed by stoi, ensuring no trailing non-digit characters
-            if (processed_chars != occurrence_str.length()) {
-                 cout << "Error: Invalid guess occurrences submitted: '" << occurrence_str << "'. Expected an integer." << endl;
-                 return false;
-            }
+    if (view_grid(storage, length, pattern_grid_content)) {
+        return true;
+    }
+    return parse_grid(storage.get(), length, pattern_grid_content, out);
+}
 
-            // Optional: Add a check for non-negative occurrence, as occurrences are typically non-negative
-            if (guessed_occurrences < 0) {
-                 cout << "Error: Invalid guess occurrences submitted: '" << occurrence_str << "'. Expected a non-negative integer." << endl;
-                 return false;
-            }
+get_validate_input::GridRowReader::GridRowReader()
+    : fd_(-1), rows_(0), cols_(0), data_offset_(0), stride_(0), file_size_(0) {}
 
-        } catch (const invalid_argument& ia) {
-            cout << "Error: Invalid guess occurrences submitted: '" << occurrence_str << "'. Expected an integer." << endl;
-            return false;
-        } catch (const out_of_range& oor) {
-            cout << "Error: Guess occurrences value out of integer range: '" << occurrence_str << "'" << endl;
+get_validate_input::GridRowReader::~GridRowReader() {
+    if (fd_ >= 0) close(fd_);
+}
+
+// Reads the header and the first row's terminator to learn the layout; rows are checked as they are read
+bool get_validate_input::GridRowReader::open(const string& path, ostream& out) {
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd_ < 0 || fstat(fd_, &info) != 0) {
+        out << "Error: Could not open the file '" << path << "': " << strerror(errno) << endl;
+        return false;
+    }
+    file_size_ = info.st_size;
+
+    char head[256];
+    ssize_t got = pread(fd_, head, sizeof(head), 0);
+    const char* newline = got > 0 ? static_cast<const char*>(memchr(head, '\n', got)) : nullptr;
+    size_t rows = 0;
+    size_t cols = 0;
+    stringstream ss_dims(newline ? string(static_cast<const char*>(head), newline) : string());
+    if (!(ss_dims >> rows >> cols) || rows == 0 || cols == 0 || rows > INT_MAX || cols > INT_MAX) {
+        out << "Error: Could not parse valid positive rows and columns from the first line of the file." << endl;
+        return false;
+    }
+    rows_ = rows;
+    cols_ = cols;
+    data_offset_ = newline - head + 1;
+
+    char terminator[2] = {0, 0};
+    pread(fd_, terminator, 2, data_offset_ + cols);
+    stride_ = (terminator[0] == '\r' && terminator[1] == '\n') ? cols + 2 : cols + 1;
+    if (data_offset_ + (rows - 1) * stride_ + cols > file_size_) {
+        out << "Error: Dimensions " << rows << " x " << cols << " from the first line do not fit in the file." << endl;
+        return false;
+    }
+    return true;
+}
+
+bool get_validate_input::GridRowReader::read_rows(int first, int count, char* out) {
+    if (first < 0 || count < 0 || first + count > rows_) {
+        return false;
+    }
+    size_t offset = data_offset_ + static_cast<size_t>(first) * stride_;
+    size_t wanted = min(static_cast<size_t>(count) * stride_, file_size_ - offset); // The last row may be unterminated
+    chunk_.resize(wanted);
+    size_t done = 0;
+    while (done < wanted) {
+        ssize_t got = pread(fd_, &chunk_[done], wanted - done, offset + done);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        done += got;
+    }
+    for (int r = 0; r < count; ++r) {
+        const char* row = &chunk_[static_cast<size_t>(r) * stride_];
+        bool terminated = first + r + 1 == rows_ ||
+                          (stride_ == static_cast<size_t>(cols_) + 1 ? row[cols_] == '\n' : row[cols_] == '\r' && row[cols_ + 1] == '\n');
+        if (!terminated || !match_kernel::all_uppercase(row, cols_)) {
             return false;
         }
+        memcpy(out + static_cast<size_t>(r) * cols_, row, cols_);
+    }
+    return true;
+}
 
-        // retrieve the convertToNum radio button
-        // Assuming the radio button's name is "conversion" based on your HTML
-        const_form_iterator conversion_iter = cgi.getElement("conversion"); // Updated iterator name and declared here
-        if (conversion_iter != cgi.getElements().end() && conversion_iter->getValue() == "convert") {
-            convertToNumber = true;
-        } else {
-            convertToNumber = false;
+// Splits a form value into its items; items may be separated by commas and/or whitespace
+vector<string> get_validate_input::split_list(const string& str) {
+    vector<string> items;
+    const char* separators = ", \t\n\r\f\v";
+    size_t start = str.find_first_not_of(separators);
+    while (start != string::npos) {
+        size_t end = str.find_first_of(separators, start);
+        items.push_back(str.substr(start, end == string::npos ? string::npos : end - start));
+        start = str.find_first_not_of(separators, end);
+    }
+    return items;
+}
+
+// Reads the submitted form through cgicc into a FormInput. Only the first value of each
+// field is kept, matching Cgicc::getElement. A failure to read the form at all is recorded
+// in input.error and reported by validate_form.
+bool get_validate_input::read_cgi_form(FormInput& input) {
+    try {
+        Cgicc cgi; // Create CGI object to access form data
+
+        for (const FormEntry& entry : cgi.getElements()) {
+            input.fields.insert(make_pair(entry.getName(), entry.getValue()));
         }
 
         // Access the uploaded file from the form using its name "pattern_file"
         file_iterator fileIter = cgi.getFile("pattern_file");
-        if (fileIter == cgi.getFiles().end()) {
-            cout << "Error: File input field 'pattern_file' not found in the submitted form data." << endl;
-            return false;
+        if (fileIter != cgi.getFiles().end()) {
+            input.has_pattern_file = true;
+            input.pattern_file = fileIter->getData();
         }
 
-        const FormFile& fileRef = *fileIter;
-         // Check if the uploaded file is empty
-        if (fileRef.getDataLength() == 0) {
-            cout << "Error: Uploaded file 'pattern_file' is empty." << endl;
-            return false;
+        const char* accept_encoding = getenv("HTTP_ACCEPT_ENCODING");
+        if (accept_encoding != nullptr) {
+            input.accept_encoding = accept_encoding;
         }
-        // Read the file contents into a string stream
-        stringstream ss_file_content(fileRef.getData());
-        string line;
+        return true;
 
-        size_t rows = 0;
-        size_t cols = 0;
+    } catch (const exception& e) {
+        input.error = string("Exception caught during form data processing: ") + e.what();
+        return false;
+    } catch (...) {
+        input.error = "Unknown exception caught during form data processing.";
+        return false;
+    }
+}
 
-        // Read the first line which should contain the dimensions (rows and columns)
-        if (getline(ss_file_content, line)) {
-            stringstream ss_dims(line);
-            if (!(ss_dims >> rows >> cols) || rows == 0 || cols == 0) {
-                cout << "Error: Could not parse valid positive rows and columns from the first line of the file: '" << line << "'" << endl;
+// Extracts and validates the form fields: the guessed pattern strings, the guessed occurrences
+// counts, the convert option, and that a non-empty pattern file was uploaded (it is not parsed here).
+// "guess_pattern" may hold a list of patterns; "guess_occurrences" then holds one count per pattern.
+// Error messages are written to out, which is the page being generated.
+// Variable names aligned with HTML form field names where appropriate.
+bool get_validate_input::validate_fields(const FormInput& input, vector<string>& guessed_patterns, vector<int>& guessed_occurrences, bool& convertToNumber, ostream& out) {
+    if (!input.error.empty()) {
+        out << input.error << endl;
+        return false;
+    }
+    try {
+        // Retrieve the "guess_pattern" field from the form
+        map<string, string>::const_iterator guess_pattern_iter = input.fields.find("guess_pattern");
+        if (guess_pattern_iter == input.fields.end() || guess_pattern_iter->second.empty()) {
+            out << "Error: Form field 'guess_pattern' not found or empty." << endl;
+            return false;
+        }
+        guessed_patterns = split_list(guess_pattern_iter->second); // Assign value to the updated variable name
+        if (guessed_patterns.empty()) {
+            out << "Error: Form field 'guess_pattern' not found or empty." << endl;
+            return false;
+        }
+
+        // Validate each guessed pattern string (e.g., check if it's empty or contains invalid characters)
+        // Assuming only uppercase letters are allowed in the pattern string based on previous logic.
+        for (const string& guessed_pattern : guessed_patterns) {
+            if (guessed_pattern.empty() || !is_uppercase(guessed_pattern)) { // Assuming is_uppercase can handle strings > 1 char
+                out << "Error: Invalid guess pattern submitted: '" << guessed_pattern << "'. Expected one or more uppercase letters." << endl;
                 return false;
             }
-        } else {
-            cout << "Error: Uploaded file content seems empty or invalid after checking size (could not read first line)." << endl;
+        }
+
+
+        // Retrieve the "guess_occurrences" field from the form
+        map<string, string>::const_iterator guess_occurrences_iter = input.fields.find("guess_occurrences");
+        if (guess_occurrences_iter == input.fields.end() || guess_occurrences_iter->second.empty()) {
+            out << "Error: Form field 'guess_occurrences' not found or empty." << endl;
             return false;
         }
+        vector<string> occurrence_strs = split_list(guess_occurrences_iter->second); // Get string values from the field
+        if (occurrence_strs.size() != guessed_patterns.size()) {
+            out << "Error: Got " << occurrence_strs.size() << " guessed occurrence counts for "
+                 << guessed_patterns.size() << " patterns. Expected one count per pattern." << endl;
+            return false;
+        }
+
+        guessed_occurrences.clear();
+        for (const string& occurrence_str : occurrence_strs) {
+            // Convert the string value to an integer and validate
+            try {
+                size_t processed_chars;
+                int guessed_occurrence = stoi(occurrence_str, &processed_chars); // Convert the value for this pattern
 
-        pattern_grid_content.clear(); // Clear the vector to store new content
-        size_t actual_rows_read = 0;
-        // Read and validate each line of the pattern data
-        while (getline(ss_file_content, line)) {
-            string trimmed_line = trim(line);
-
-            if (!trimmed_line.empty()) {
-            // Each line must have the correct number of columns and be uppercase
-                if (trimmed_line.length() == cols && is_uppercase(trimmed_line)) {
-                    pattern_grid_content.push_back(trimmed_line); // Store line in the updated variable name
-                    actual_rows_read++;
-                } else {
-                    cout << "Error: Invalid pattern line format or content found. Line: '" << trimmed_line << "'. Expected " << cols << " uppercase characters." << endl;
-                    return false;
+                // Check if the entire string was consumed by stoi, ensuring no trailing non-digit characters
+                if (processed_chars != occurrence_str.length()) {
+                     out << "Error: Invalid guess occurrences submitted: '" << occurrence_str << "'. Expected an integer." << endl;
+                     return false;
                 }
+
+                // Optional: Add a check for non-negative occurrence, as occurrences are typically non-negative
+                if (guessed_occurrence < 0) {
+                     out << "Error: Invalid guess occurrences submitted: '" << occurrence_str << "'. Expected a non-negative integer." << endl;
+                     return false;
+                }
+                guessed_occurrences.push_back(guessed_occurrence);
+
+            } catch (const invalid_argument& ia) {
+                out << "Error: Invalid guess occurrences submitted: '" << occurrence_str << "'. Expected an integer." << endl;
+                return false;
+            } catch (const out_of_range& oor) {
+                out << "Error: Guess occurrences value out of integer range: '" << occurrence_str << "'" << endl;
+                return false;
             }
         }
-         // Ensure the number of valid rows read matches the expected number
-        if (actual_rows_read != rows) {
-            cout << "Error: Number of valid pattern rows read (" << actual_rows_read
-                 << ") does not match the expected number of rows (" << rows
-                 << ") specified in the first line." << endl;
+
+        // retrieve the convertToNum radio button
+        // Assuming the radio button's name is "conversion" based on your HTML
+        map<string, string>::const_iterator conversion_iter = input.fields.find("conversion"); // Updated iterator name and declared here
+        if (conversion_iter != input.fields.end() && conversion_iter->second == "convert") {
+            convertToNumber = true;
+        } else {
+            convertToNumber = false;
+        }
+
+        // The uploaded file from the form field "pattern_file"
+        if (!input.has_pattern_file) {
+            out << "Error: File input field 'pattern_file' not found in the submitted form data." << endl;
+            return false;
+        }
+
+         // Check if the uploaded file is empty
+        if (input.pattern_file.empty()) {
+            out << "Error: Uploaded file 'pattern_file' is empty." << endl;
             return false;
         }
         // All validations passed
@@ -164,11 +575,37 @@ bool get_validate_input::get_form_data(vector<string>& pattern_grid_content, str
 
     } catch (const exception& e) {
         // Catch and print any standard exceptions
-        cout << "Exception caught during form data processing: " << e.what() << endl;
+        out << "Exception caught during form data processing: " << e.what() << endl;
         return false;
     } catch (...) {
         // Catch any unknown exceptions
-        cout << "Unknown exception caught during form data processing." << endl;
+        out << "Unknown exception caught during form data processing." << endl;
         return false;
     }
 }
+
+// Validates the form fields, then parses the uploaded pattern file into the grid
+bool get_validate_input::validate_form(const FormInput& input, pattern_grid::Grid& pattern_grid_content, vector<string>& guessed_patterns, vector<int>& guessed_occurrences, bool& convertToNumber, ostream& out) {
+    if (!validate_fields(input, guessed_patterns, guessed_occurrences, convertToNumber, out)) {
+        return false;
+    }
+    try {
+        // Parse the upload's buffer in place
+        request_metrics::ScopedTimer parse_timer(request_metrics::PARSE);
+        request_metrics::add(request_metrics::BYTES_PARSED, input.pattern_file.size());
+        return parse_grid(input.pattern_file.data(), input.pattern_file.size(), pattern_grid_content, out);
+    } catch (const exception& e) {
+        out << "Exception caught during form data processing: " << e.what() << endl;
+        return false;
+    } catch (...) {
+        out << "Unknown exception caught during form data processing." << endl;
+        return false;
+    }
+}
+
+// Reads the CGI form and validates it, printing any errors to the page
+bool get_validate_input::get_form_data(pattern_grid::Grid& pattern_grid_content, vector<string>& guessed_patterns, vector<int>& guessed_occurrences, bool& convertToNumber) {
+    FormInput input;
+    read_cgi_form(input);
+    return validate_form(input, pattern_grid_content, guessed_patterns, guessed_occurrences, convertToNumber, cout);
+}
@@ -6,12 +6,108 @@
 #include <vector>
 #include <sstream>
 #include <cstdlib>
+#include <cstdint>
+#include <map>
+#include "pattern_grid.h"
 using namespace std;
 
 namespace get_validate_input {
+    // The submitted form fields and uploaded file, whether they came through cgicc or the built-in server
+    struct FormInput {
+        map<string, string> fields;    // First value of each form field
+        bool has_pattern_file = false; // True if a "pattern_file" part was uploaded
+        string pattern_file;           // Contents of the uploaded "pattern_file"
+        string error;                  // Set if the form could not be read at all
+        string accept_encoding;        // The request's Accept-Encoding header, for compressing the page
+    };
+
+    // Reads rows of a grid file on demand, for grids too large to load at once. The file must use the
+    // plain layout load_grid_file can view in place: the "rows cols" line, then every row as exactly
+    // cols uppercase letters followed by "\n" or "\r\n".
+    class GridRowReader {
+    public:
+        GridRowReader();
+        ~GridRowReader();
+        GridRowReader(const GridRowReader&) = delete;
+        GridRowReader& operator=(const GridRowReader&) = delete;
+
+        bool open(const string& path, ostream& out = cout);
+        int rows() const { return rows_; }
+        int cols() const { return cols_; }
+
+        // Copies rows [first, first + count) into out, cols bytes per row; false on a read error or an invalid row
+        bool read_rows(int first, int count, char* out);
+
+    private:
+        int fd_;
+        int rows_;
+        int cols_;
+        size_t data_offset_; // Where row 0 starts
+        size_t stride_;      // cols plus the line terminator
+        size_t file_size_;
+        vector<char> chunk_;
+    };
+
+    // Packed grid format, accepted wherever the text format is (uploads and grid files) and told apart
+    // by its magic: a 20-byte header, then the cells in reading order as 5-bit codes ('A' = 0 ...
+    // 'Z' = 25), least significant bit first, the last byte padded with zero bits. Over a third smaller
+    // than the text, and rows are unpacked without per-character parsing.
+    //   bytes 0-3    "P3G5"
+    //   bytes 4-7    rows, little-endian
+    //   bytes 8-11   cols, little-endian
+    //   bytes 12-19  checksum of the packed cells, little-endian: match_kernel::checksum of each
+    //                64 KiB block in turn, seeded with the previous block's (0 for the first)
+    const size_t PACKED_HEADER_BYTES = 20;
+    // grid (of 'A'-'Z' cells) in the packed format
+    string pack_grid(const pattern_grid::Grid& grid);
+
+    // parse_grid in steps, so rows can be used while later ones are still being parsed. Error
+    // messages are the ones parse_grid writes.
+    class GridParser {
+    public:
+        GridParser();
+
+        // Reads the "rows cols" line (or the packed header) and allocates grid from it; false if the
+        // dimensions are invalid
+        bool begin(const char* data, size_t length, pattern_grid::Grid& grid, ostream& out = cout);
+        // Parses up to max_rows more rows into the grid; false on an invalid line
+        bool parse_rows(size_t max_rows, ostream& out = cout);
+        // Checks everything after the rows parsed so far: false if a line is invalid, rows are missing or
+        // extra, or a packed grid's checksum does not match
+        bool finish(ostream& out = cout);
+
+        size_t rows_parsed() const { return rows_read_; }
+        // True once every row is parsed (finish() may still find extra lines)
+        bool all_rows_parsed() const { return rows_read_ == rows_; }
+
+    private:
+        bool begin_packed(const char* data, size_t length, pattern_grid::Grid& grid, ostream& out);
+        bool next_line(const char*& first, const char*& last);
+        bool valid_line(const char* first, const char* last, ostream& out) const;
+        void hash_packed_through(size_t bytes);
+
+        pattern_grid::Grid* grid_;
+        const char* next_; // Start of the next unread line
+        const char* end_;
+        size_t rows_;
+        size_t cols_;
+        size_t rows_read_;
+        const unsigned char* packed_; // Packed cells, or null for the text format
+        size_t packed_bytes_;
+        size_t hashed_bytes_;         // Packed cells already added to checksum_, a whole number of blocks
+        uint64_t checksum_;
+        uint64_t expected_checksum_;
+    };
+
     string trim(const string& str);
     bool is_uppercase(const string& str);
-    bool get_form_data(vector<string>& pattern, string& guess, int& occurrence, bool& convertToNumber);
+    vector<string> split_list(const string& str);
+    bool parse_grid(const char* data, size_t length, pattern_grid::Grid& pattern, ostream& out = cout);
+    bool load_grid_file(const string& path, pattern_grid::Grid& pattern, ostream& out = cout);
+    bool read_cgi_form(FormInput& input);
+    bool validate_fields(const FormInput& input, vector<string>& guesses, vector<int>& occurrences, bool& convertToNumber, ostream& out);
+    bool validate_form(const FormInput& input, pattern_grid::Grid& pattern, vector<string>& guesses, vector<int>& occurrences, bool& convertToNumber, ostream& out);
+    bool get_form_data(pattern_grid::Grid& pattern, vector<string>& guesses, vector<int>& occurrences, bool& convertToNumber);
 } // namespace get_validate_input
 
 #endif
@@ -0,0 +1,413 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "grid_index.h"
+#include "match_kernel.h" // For checking that a grid or pattern is all uppercase
+#include "request_metrics.h" // Stage timers and counters
+
+using namespace std;
+
+static const char FILE_MAGIC[4] = {'P', '3', 'G', 'I'};
+static const uint32_t FILE_VERSION = 1;
+static const int TRIGRAM_COUNT = 26 * 26 * 26;
+// A pattern whose rarest trigram starts on more than 1 in this many cells is found faster by the
+// SIMD scan than by decoding its postings
+static const uint64_t DENSE_CELLS_PER_START = 16;
+
+// Start of the buffer; the two line directions' counts and offsets follow it, then their varints
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t rows;
+    int32_t cols;
+    uint64_t grid_hash;
+    uint64_t posting_bytes[2]; // Rows, columns
+};
+
+static size_t table_bytes() {
+    return TRIGRAM_COUNT * sizeof(uint32_t) + (TRIGRAM_COUNT + 1) * sizeof(uint64_t);
+}
+
+static inline int trigram(const char* s) {
+    return ((s[0] - 'A') * 26 + (s[1] - 'A')) * 26 + (s[2] - 'A');
+}
+
+static inline size_t varint_length(uint64_t value) {
+    size_t n = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++n;
+    }
+    return n;
+}
+
+static inline unsigned char* put_varint(unsigned char* out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<unsigned char>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<unsigned char>(value);
+    return out;
+}
+
+// Decodes one trigram's list of starts, stopping early (and failing) if the varints run past end
+class PostingReader {
+public:
+    PostingReader(const unsigned char* begin, const unsigned char* end, uint32_t count)
+        : next_(begin), end_(end), left_(count), value_(0), failed_(false) {}
+
+    bool next(uint64_t& value) {
+        if (left_ == 0) return false;
+        uint64_t delta = 0;
+        int shift = 0;
+        for (;;) {
+            if (next_ == end_ || shift > 63) {
+                failed_ = true;
+                return false;
+            }
+            unsigned char byte = *next_++;
+            delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+            shift += 7;
+        }
+        --left_;
+        value = value_ += delta;
+        return true;
+    }
+
+    bool failed() const { return failed_; }
+
+private:
+    const unsigned char* next_;
+    const unsigned char* end_;
+    uint32_t left_;
+    uint64_t value_;
+    bool failed_;
+};
+
+grid_index::GridIndex::GridIndex() : data_(nullptr), size_(0), damaged_(false) {
+    lines_[0] = lines_[1] = Postings{nullptr, nullptr, nullptr};
+}
+
+// Two passes over each line direction: the first sizes every trigram's varints, the second writes them
+bool grid_index::GridIndex::build(const pattern_grid::Grid& grid, uint64_t grid_hash) {
+    storage_.reset();
+    data_ = nullptr;
+    size_ = 0;
+    int rows = grid.rows();
+    int cols = grid.cols();
+    if (static_cast<uint64_t>(rows) * cols > UINT32_MAX) {
+        return false; // Posting counts are 32-bit
+    }
+    for (int r = 0; r < rows; ++r) {
+        if (!match_kernel::all_uppercase(grid.row(r), cols)) return false;
+    }
+
+    vector<uint32_t> counts[2];
+    vector<uint64_t> offsets[2];
+    vector<uint64_t> last(TRIGRAM_COUNT);
+    for (int d = 0; d < 2; ++d) {
+        int lines = d ? cols : rows;
+        int length = d ? rows : cols;
+        counts[d].assign(TRIGRAM_COUNT, 0);
+        offsets[d].assign(TRIGRAM_COUNT + 1, 0);
+        last.assign(TRIGRAM_COUNT, 0);
+        pattern_grid::ColumnReader columns(grid);
+        for (int i = 0; i < lines; ++i) {
+            const char* line = d ? columns.column(i) : grid.row(i);
+            uint64_t base = static_cast<uint64_t>(i) * length;
+            for (int k = 0; k + 3 <= length; ++k) {
+                int t = trigram(line + k);
+                offsets[d][t + 1] += varint_length(base + k - last[t]);
+                last[t] = base + k;
+                ++counts[d][t];
+            }
+        }
+        for (int t = 0; t < TRIGRAM_COUNT; ++t) offsets[d][t + 1] += offsets[d][t];
+    }
+
+    size_t size = sizeof(FileHeader) + 2 * table_bytes() + offsets[0][TRIGRAM_COUNT] + offsets[1][TRIGRAM_COUNT];
+    shared_ptr<char> buffer(new char[size], default_delete<char[]>());
+    FileHeader header;
+    memcpy(header.magic, FILE_MAGIC, 4);
+    header.version = FILE_VERSION;
+    header.rows = rows;
+    header.cols = cols;
+    header.grid_hash = grid_hash;
+    header.posting_bytes[0] = offsets[0][TRIGRAM_COUNT];
+    header.posting_bytes[1] = offsets[1][TRIGRAM_COUNT];
+    memcpy(buffer.get(), &header, sizeof(header));
+    char* tables = buffer.get() + sizeof(FileHeader);
+    for (int d = 0; d < 2; ++d) {
+        memcpy(tables + d * table_bytes(), counts[d].data(), TRIGRAM_COUNT * sizeof(uint32_t));
+        memcpy(tables + d * table_bytes() + TRIGRAM_COUNT * sizeof(uint32_t), offsets[d].data(), (TRIGRAM_COUNT + 1) * sizeof(uint64_t));
+    }
+
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(tables + 2 * table_bytes());
+    vector<unsigned char*> cursor(TRIGRAM_COUNT);
+    for (int d = 0; d < 2; ++d) {
+        int lines = d ? cols : rows;
+        int length = d ? rows : cols;
+        for (int t = 0; t < TRIGRAM_COUNT; ++t) cursor[t] = bytes + offsets[d][t];
+        last.assign(TRIGRAM_COUNT, 0);
+        pattern_grid::ColumnReader columns(grid);
+        for (int i = 0; i < lines; ++i) {
+            const char* line = d ? columns.column(i) : grid.row(i);
+            uint64_t base = static_cast<uint64_t>(i) * length;
+            for (int k = 0; k + 3 <= length; ++k) {
+                int t = trigram(line + k);
+                cursor[t] = put_varint(cursor[t], base + k - last[t]);
+                last[t] = base + k;
+            }
+        }
+        bytes += offsets[d][TRIGRAM_COUNT];
+    }
+    return attach(buffer, size);
+}
+
+// Points lines_ into a buffer in the file layout after checking that its tables are consistent
+bool grid_index::GridIndex::attach(shared_ptr<const char> storage, size_t size) {
+    if (size < sizeof(FileHeader) + 2 * table_bytes()) return false;
+    FileHeader header;
+    memcpy(&header, storage.get(), sizeof(header));
+    const char* tables = storage.get() + sizeof(FileHeader);
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(tables + 2 * table_bytes());
+    size_t remaining = size - sizeof(FileHeader) - 2 * table_bytes();
+    Postings lines[2];
+    for (int d = 0; d < 2; ++d) {
+        lines[d].counts = reinterpret_cast<const uint32_t*>(tables + d * table_bytes());
+        lines[d].offsets = reinterpret_cast<const uint64_t*>(tables + d * table_bytes() + TRIGRAM_COUNT * sizeof(uint32_t));
+        lines[d].bytes = bytes;
+        if (header.posting_bytes[d] > remaining || lines[d].offsets[0] != 0 || lines[d].offsets[TRIGRAM_COUNT] != header.posting_bytes[d]) {
+            return false;
+        }
+        for (int t = 0; t < TRIGRAM_COUNT; ++t) {
+            if (lines[d].offsets[t] > lines[d].offsets[t + 1]) return false;
+        }
+        bytes += header.posting_bytes[d];
+        remaining -= header.posting_bytes[d];
+    }
+    if (remaining != 0) return false;
+
+    storage_ = storage;
+    data_ = storage_.get();
+    size_ = size;
+    lines_[0] = lines[0];
+    lines_[1] = lines[1];
+    path_.clear();
+    damaged_ = false;
+    return true;
+}
+
+bool grid_index::GridIndex::save(const string& path) const {
+    if (empty()) return false;
+    // A temporary file of this writer's own: server threads asked about the same new grid save at once
+    string temp_path = path + ".tmpXXXXXX";
+    int fd = mkstemp(&temp_path[0]);
+    if (fd < 0) {
+        return false;
+    }
+    fchmod(fd, 0644); // mkstemp makes it private; other processes map it too
+    FILE* file = fdopen(fd, "wb");
+    if (file == nullptr) {
+        close(fd);
+        remove(temp_path.c_str());
+        return false;
+    }
+    bool ok = fwrite(data_, 1, size_, file) == size_;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+        remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool grid_index::GridIndex::load(const string& path, int rows, int cols, uint64_t grid_hash) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(FileHeader)) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    FileHeader header;
+    if (pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        memcmp(header.magic, FILE_MAGIC, 4) != 0 || header.version != FILE_VERSION ||
+        header.rows != rows || header.cols != cols || header.grid_hash != grid_hash) {
+        close(fd);
+        return false;
+    }
+    size_t length = info.st_size;
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping stays valid without the descriptor
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    madvise(mapped, length, MADV_RANDOM); // A search touches a few table entries and two posting lists
+    shared_ptr<const char> storage(static_cast<const char*>(mapped), [length](const char* p) {
+        munmap(const_cast<char*>(p), length);
+    });
+    if (!attach(storage, length)) {
+        return false;
+    }
+    path_ = path;
+    return true;
+}
+
+// Stops answering from a file whose postings do not fit its grid and deletes it, so the next open rebuilds it
+void grid_index::GridIndex::discard_damaged() const {
+    if (damaged_) return;
+    damaged_ = true;
+    if (!path_.empty()) {
+        remove(path_.c_str());
+    }
+}
+
+// True if the rarest trigram of pattern is rare enough for find_starts to beat a scan of cells cells
+bool grid_index::GridIndex::selective(const Postings& postings, const string& pattern, uint64_t cells) const {
+    if (empty() || damaged_ || pattern.length() < 3 || !match_kernel::all_uppercase(pattern.data(), pattern.length())) {
+        return !empty() && !damaged_ && pattern.length() >= 3; // Not all uppercase: no matches, nothing to decode
+    }
+    uint32_t rarest = UINT32_MAX;
+    for (size_t i = 0; i + 3 <= pattern.length(); ++i) {
+        rarest = min(rarest, postings.counts[trigram(pattern.data() + i)]);
+    }
+    return rarest * DENSE_CELLS_PER_START <= cells;
+}
+
+// Starts (cell numbers in the line direction's order) of pattern in lines of line_length cells,
+// ascending. The two rarest trigrams of the pattern are intersected and the survivors verified.
+// False if a posting list is truncated or names a cell outside the grid.
+bool grid_index::GridIndex::find_starts(const Postings& postings, const string& pattern, int line_length,
+                                        const pattern_grid::Grid& grid, bool columns, vector<uint64_t>& starts) const {
+    starts.clear();
+    int m = pattern.length();
+    if (m < 3 || m > line_length || !match_kernel::all_uppercase(pattern.data(), m)) {
+        return true;
+    }
+    uint64_t cells = static_cast<uint64_t>(grid.rows()) * grid.cols();
+
+    // Offsets in the pattern of its rarest trigram (first) and second rarest (second, or -1)
+    int first = 0;
+    int second = -1;
+    for (int i = 1; i + 3 <= m; ++i) {
+        uint32_t count = postings.counts[trigram(pattern.data() + i)];
+        if (count < postings.counts[trigram(pattern.data() + first)]) {
+            second = first;
+            first = i;
+        } else if (second < 0 || count < postings.counts[trigram(pattern.data() + second)]) {
+            second = i;
+        }
+    }
+
+    int a_trigram = trigram(pattern.data() + first);
+    PostingReader a(postings.bytes + postings.offsets[a_trigram], postings.bytes + postings.offsets[a_trigram + 1], postings.counts[a_trigram]);
+    int b_trigram = second < 0 ? 0 : trigram(pattern.data() + second);
+    PostingReader b(postings.bytes + postings.offsets[b_trigram], postings.bytes + postings.offsets[b_trigram + 1],
+                    second < 0 ? 0 : postings.counts[b_trigram]);
+
+    uint64_t a_pos, b_pos = 0;
+    bool b_valid = second >= 0 && b.next(b_pos);
+    while (a.next(a_pos)) {
+        if (a_pos >= cells) return false;
+        if (second >= 0) {
+            // A start s has s + first in a and s + second in b, i.e. a_pos + second == b_pos + first
+            while (b_valid && b_pos + first < a_pos + second) b_valid = b.next(b_pos);
+            if (!b_valid) break;
+            if (b_pos + first != a_pos + second) continue;
+        }
+        uint64_t line = a_pos / line_length;
+        int offset = static_cast<int>(a_pos % line_length);
+        if (offset < first || offset - first + m > line_length) continue; // The pattern would cross a line end
+        int start = offset - first;
+        bool match = true;
+        for (int k = 0; k < m && match; ++k) {
+            char c = columns ? grid.at(start + k, static_cast<int>(line)) : grid.row(static_cast<int>(line))[start + k];
+            match = c == pattern[k];
+        }
+        if (match) starts.push_back(a_pos - first);
+    }
+    return !a.failed() && !b.failed();
+}
+
+vector<pattern_analyzer::PatternLocation> grid_index::GridIndex::find_horizontal_locations(const pattern_grid::Grid& grid, const string& pattern) const {
+    if (!selective(lines_[0], pattern, static_cast<uint64_t>(grid.rows()) * grid.cols())) {
+        return pattern_analyzer::find_horizontal_locations(grid, pattern);
+    }
+    vector<uint64_t> starts;
+    if (!find_starts(lines_[0], pattern, grid.cols(), grid, false, starts)) {
+        discard_damaged();
+        return pattern_analyzer::find_horizontal_locations(grid, pattern);
+    }
+    vector<pattern_analyzer::PatternLocation> locations;
+    locations.reserve(starts.size());
+    for (uint64_t s : starts) {
+        locations.push_back({static_cast<int>(s / grid.cols()), static_cast<int>(s % grid.cols()), 'H', static_cast<int>(pattern.length())});
+    }
+    return locations;
+}
+
+vector<pattern_analyzer::PatternLocation> grid_index::GridIndex::find_vertical_locations(const pattern_grid::Grid& grid, const string& pattern) const {
+    if (!selective(lines_[1], pattern, static_cast<uint64_t>(grid.rows()) * grid.cols())) {
+        return pattern_analyzer::find_vertical_locations(grid, pattern);
+    }
+    vector<uint64_t> starts;
+    if (!find_starts(lines_[1], pattern, grid.rows(), grid, true, starts)) {
+        discard_damaged();
+        return pattern_analyzer::find_vertical_locations(grid, pattern);
+    }
+    vector<pattern_analyzer::PatternLocation> locations;
+    locations.reserve(starts.size());
+    for (uint64_t s : starts) {
+        locations.push_back({static_cast<int>(s % grid.rows()), static_cast<int>(s / grid.rows()), 'V', static_cast<int>(pattern.length())});
+    }
+    return locations;
+}
+
+pattern_analyzer::AnalysisResult grid_index::analyze_pattern(const pattern_grid::Grid& grid, const string& pattern, const GridIndex& index) {
+    if (pattern.empty() || grid.empty()) {
+        return pattern_analyzer::AnalysisResult();
+    }
+    vector<pattern_analyzer::PatternLocation> h_locations, v_locations;
+    {
+        request_metrics::ScopedTimer timer(request_metrics::SEARCH_H);
+        h_locations = index.find_horizontal_locations(grid, pattern);
+    }
+    {
+        request_metrics::ScopedTimer timer(request_metrics::SEARCH_V);
+        v_locations = index.find_vertical_locations(grid, pattern);
+    }
+    request_metrics::add(request_metrics::CANDIDATES, h_locations.size() + v_locations.size());
+
+    request_metrics::ScopedTimer timer(request_metrics::SELECT);
+    pattern_analyzer::AnalysisResult result = pattern_analyzer::select_horizontal_vertical(grid.rows(), grid.cols(), h_locations, v_locations);
+    request_metrics::add(request_metrics::ACCEPTED, result.count);
+    return result;
+}
+
+bool grid_index::shared_index(const pattern_grid::Grid& grid, uint64_t grid_hash, GridIndex& index) {
+    static const char* directory = getenv("PROJECT3_INDEX_DIR");
+    if (directory == nullptr || *directory == '\0') {
+        return false;
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "/%016llx-%dx%d.idx", static_cast<unsigned long long>(grid_hash), grid.rows(), grid.cols());
+    string path = string(directory) + name;
+    if (index.load(path, grid.rows(), grid.cols(), grid_hash)) {
+        return true;
+    }
+    if (!index.build(grid, grid_hash)) {
+        return false;
+    }
+    index.save(path); // Best effort; this request uses the built index either way
+    return true;
+}
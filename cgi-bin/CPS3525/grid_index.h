@@ -0,0 +1,74 @@
+#ifndef GRID_INDEX_H
+#define GRID_INDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "pattern_grid.h"
+#include "pattern_analyzer.h"
+
+using namespace std;
+
+// Namespace for the optional per-grid position index. When many different patterns are asked
+// against one grid, building the index once turns every later horizontal/vertical search into a
+// lookup whose cost follows the number of matches instead of the grid's area.
+namespace grid_index {
+
+    // Trigram posting index over the rows and over the columns of one grid of uppercase letters.
+    // For every trigram and each line direction it lists where the trigram starts (row-major cell
+    // number for rows, column-major for columns), as delta-encoded varints. A search intersects the
+    // two rarest trigrams of the pattern and checks the surviving starts against the grid.
+    // The in-memory layout is the file layout, so a saved index is used straight from an mmap.
+    class GridIndex {
+    public:
+        GridIndex();
+
+        // Indexes grid; false (and the index stays empty) if a cell is not 'A'-'Z'
+        bool build(const pattern_grid::Grid& grid, uint64_t grid_hash);
+        // Writes the index to path (through a temporary file per writer, so readers never see half of it)
+        bool save(const string& path) const;
+        // Maps an index saved for a grid with these dimensions and hash; false if there is none or it does not fit.
+        // A mapped file found damaged during a search is deleted and the search falls back to the scan.
+        bool load(const string& path, int rows, int cols, uint64_t grid_hash);
+
+        bool empty() const { return data_ == nullptr; }
+        size_t size_bytes() const { return size_; }
+
+        // Same locations, in the same order, as pattern_analyzer::find_horizontal_locations and
+        // find_vertical_locations. grid must be the indexed grid. Patterns shorter than a trigram, or
+        // with matches on so many cells that decoding would cost more than scanning, fall back to the scan.
+        vector<pattern_analyzer::PatternLocation> find_horizontal_locations(const pattern_grid::Grid& grid, const string& pattern) const;
+        vector<pattern_analyzer::PatternLocation> find_vertical_locations(const pattern_grid::Grid& grid, const string& pattern) const;
+
+    private:
+        // One line direction's postings
+        struct Postings {
+            const uint32_t* counts;  // Starts per trigram
+            const uint64_t* offsets; // Where each trigram's varints begin in bytes (one extra entry at the end)
+            const unsigned char* bytes;
+        };
+
+        bool attach(shared_ptr<const char> storage, size_t size);
+        bool selective(const Postings& postings, const string& pattern, uint64_t cells) const;
+        bool find_starts(const Postings& postings, const string& pattern, int line_length,
+                         const pattern_grid::Grid& grid, bool columns, vector<uint64_t>& starts) const;
+        void discard_damaged() const;
+
+        shared_ptr<const char> storage_; // Built buffer or file mapping
+        const char* data_;
+        size_t size_;
+        Postings lines_[2]; // Rows, columns
+        string path_;           // File the index was mapped from (empty if built)
+        mutable bool damaged_;  // Set once a search finds the postings inconsistent with the grid
+    };
+
+    // analyze_pattern (right and down only) with both searches answered from index
+    pattern_analyzer::AnalysisResult analyze_pattern(const pattern_grid::Grid& grid, const string& pattern, const GridIndex& index);
+
+    // Index for grid kept in PROJECT3_INDEX_DIR, named after its hash and dimensions: mapped when it is
+    // already there, otherwise built and saved for the next request. False if the directory is not set.
+    bool shared_index(const pattern_grid::Grid& grid, uint64_t grid_hash, GridIndex& index);
+} // namespace grid_index
+
+#endif // GRID_INDEX_H
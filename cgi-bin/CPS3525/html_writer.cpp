@@ -0,0 +1,166 @@
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#include <zlib.h>
+#include "html_writer.h"
+
+using namespace std;
+
+// zlib state for an encoded page; output is collected in its own chunk before it is sent
+struct html_writer::Writer::Compressor {
+    z_stream stream;
+    vector<char> output;
+};
+
+html_writer::Encoding html_writer::negotiate_encoding(const string& accept_encoding) {
+    bool gzip = false;
+    bool deflate = false;
+    size_t start = 0;
+    while (start < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', start);
+        if (end == string::npos) end = accept_encoding.size();
+        string item = accept_encoding.substr(start, end - start);
+        start = end + 1;
+
+        // "name" or "name;q=value"; a zero quality means the coding is refused
+        size_t semicolon = item.find(';');
+        string name;
+        for (char c : item.substr(0, semicolon)) {
+            if (!isspace(static_cast<unsigned char>(c))) name += tolower(static_cast<unsigned char>(c));
+        }
+        if (semicolon != string::npos) {
+            size_t q = item.find("q=", semicolon);
+            if (q != string::npos && atof(item.c_str() + q + 2) <= 0.0) continue;
+        }
+        if (name == "gzip" || name == "x-gzip" || name == "*") gzip = true;
+        else if (name == "deflate") deflate = true;
+    }
+    return gzip ? GZIP : deflate ? DEFLATE : IDENTITY;
+}
+
+const char* html_writer::encoding_name(Encoding encoding) {
+    return encoding == GZIP ? "gzip" : encoding == DEFLATE ? "deflate" : "";
+}
+
+html_writer::Writer::Writer(int fd) : fd_(fd), target_(nullptr), buffer_(CHUNK_BYTES), used_(0), emitted_(0), ok_(true), encoding_(IDENTITY) {}
+
+html_writer::Writer::Writer(string& target) : fd_(-1), target_(&target), buffer_(CHUNK_BYTES), used_(0), emitted_(0), ok_(true), encoding_(IDENTITY) {}
+
+html_writer::Writer::~Writer() {
+    finish();
+}
+
+// Copies runs that need no escaping in one piece
+void html_writer::Writer::text(const char* data, size_t n) {
+    size_t clean = 0;
+    for (size_t i = 0; i < n; ++i) {
+        char c = data[i];
+        if (c == '&' || c == '<' || c == '>' || c == '"') {
+            raw(data + clean, i - clean);
+            text(c);
+            clean = i + 1;
+        }
+    }
+    raw(data + clean, n - clean);
+}
+
+void html_writer::Writer::number(long long value) {
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+    unsigned long long magnitude = value < 0 ? 0ULL - static_cast<unsigned long long>(value) : value;
+    do {
+        *--p = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) {
+        *--p = '-';
+    }
+    raw(p, end - p);
+}
+
+void html_writer::Writer::flush() {
+    if (used_ > 0) {
+        emit(buffer_.data(), used_);
+        used_ = 0;
+    }
+}
+
+void html_writer::Writer::begin_encoding(Encoding encoding) {
+    finish();
+    if (encoding == IDENTITY) {
+        return;
+    }
+    unique_ptr<Compressor> compressor(new Compressor());
+    // windowBits 15 + 16 selects the gzip wrapper; plain 15 is the zlib format HTTP calls "deflate"
+    int window_bits = encoding == GZIP ? 15 + 16 : 15;
+    if (deflateInit2(&compressor->stream, Z_BEST_SPEED, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return; // Fall back to sending the page as is; encoding() stays IDENTITY
+    }
+    compressor->output.resize(CHUNK_BYTES);
+    compressor_ = std::move(compressor);
+    encoding_ = encoding;
+}
+
+void html_writer::Writer::finish() {
+    flush();
+    if (compressor_) {
+        deflate_into(nullptr, 0, Z_FINISH);
+        deflateEnd(&compressor_->stream);
+        compressor_.reset();
+    }
+    encoding_ = IDENTITY;
+}
+
+void html_writer::Writer::reset() {
+    used_ = 0;
+    if (compressor_) {
+        deflateEnd(&compressor_->stream);
+        compressor_.reset();
+    }
+    encoding_ = IDENTITY;
+}
+
+void html_writer::Writer::emit(const char* data, size_t n) {
+    emitted_ += n;
+    if (compressor_) {
+        deflate_into(data, n, Z_NO_FLUSH);
+    } else {
+        send(data, n);
+    }
+}
+
+// Runs data through the compressor and sends every full (or, at the end, final) output chunk
+void html_writer::Writer::deflate_into(const char* data, size_t n, int mode) {
+    z_stream& stream = compressor_->stream;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = n;
+    int status;
+    do {
+        stream.next_out = reinterpret_cast<Bytef*>(compressor_->output.data());
+        stream.avail_out = compressor_->output.size();
+        status = deflate(&stream, mode);
+        send(compressor_->output.data(), compressor_->output.size() - stream.avail_out);
+    } while (status == Z_OK && (stream.avail_out == 0 || mode == Z_FINISH));
+}
+
+// Sends data to the destination; write(2) may accept less than asked, so loop until done
+void html_writer::Writer::send(const char* data, size_t n) {
+    if (target_ != nullptr) {
+        target_->append(data, n);
+        return;
+    }
+    while (ok_ && n > 0) {
+        ssize_t written = write(fd_, data, n);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            ok_ = false; // Client went away; nothing more to do with the page
+            return;
+        }
+        data += written;
+        n -= written;
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef HTML_WRITER_H
+#define HTML_WRITER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstddef>
+
+using namespace std;
+
+// Namespace for writing the result page straight into an output buffer instead of building strings
+namespace html_writer {
+
+    // Size of one output chunk; a full chunk is handed to the destination in one call
+    const size_t CHUNK_BYTES = 64u << 10;
+
+    // Content-Encoding applied to the page
+    enum Encoding { IDENTITY, GZIP, DEFLATE };
+
+    // Picks gzip (preferred) or deflate from an Accept-Encoding header value; IDENTITY if neither is accepted
+    Encoding negotiate_encoding(const string& accept_encoding);
+
+    // Content-Encoding header value for encoding ("gzip" or "deflate"; "" for IDENTITY)
+    const char* encoding_name(Encoding encoding);
+
+    // Appends page fragments to a fixed buffer and flushes it in chunks, either with one write(2)
+    // per chunk to a file descriptor (the CGI program's stdout) or by appending to a string (the
+    // server's reused response buffer). The buffer is allocated once and reused for every chunk.
+    class Writer {
+    public:
+        explicit Writer(int fd);
+        explicit Writer(string& target);
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        // Markup and other trusted text, written as is
+        void raw(const char* data, size_t n) {
+            if (n > buffer_.size() - used_) {
+                flush();
+                if (n >= buffer_.size()) {
+                    emit(data, n); // Too large to be worth copying through the buffer
+                    return;
+                }
+            }
+            memcpy(&buffer_[used_], data, n);
+            used_ += n;
+        }
+        void raw(const string& s) { raw(s.data(), s.size()); }
+        void raw(const char* s) { raw(s, strlen(s)); }
+
+        // User-supplied text, with &, <, > and " escaped
+        void text(char c) {
+            switch (c) {
+                case '&': raw("&amp;", 5); break;
+                case '<': raw("&lt;", 4); break;
+                case '>': raw("&gt;", 4); break;
+                case '"': raw("&quot;", 6); break;
+                default:
+                    if (used_ == buffer_.size()) flush();
+                    buffer_[used_++] = c;
+            }
+        }
+        void text(const char* data, size_t n);
+        void text(const string& s) { text(s.data(), s.size()); }
+
+        // Decimal integer
+        void number(long long value);
+
+        // Hands the buffered bytes to the destination
+        void flush();
+
+        // Compresses everything written from now on with encoding (zlib, fastest level) until finish().
+        // If zlib cannot be set up the page is written as is; encoding() tells which one applies.
+        void begin_encoding(Encoding encoding);
+
+        // Encoding actually applied to what is written now: build the Content-Encoding header from this
+        Encoding encoding() const { return encoding_; }
+
+        // Flushes and, if compressing, ends the compressed stream; the writer can then be reused
+        void finish();
+
+        // Drops the buffered bytes and any compressed stream without sending them, so a writer left
+        // mid-page by a failed request can be reused for the next one
+        void reset();
+
+        // Page bytes written so far, counted before any compression
+        size_t bytes_written() const { return emitted_ + used_; }
+
+        // False once a write to the file descriptor has failed; later output is dropped
+        bool ok() const { return ok_; }
+
+    private:
+        struct Compressor;
+
+        void emit(const char* data, size_t n);
+        void deflate_into(const char* data, size_t n, int mode);
+        void send(const char* data, size_t n);
+
+        int fd_;
+        string* target_;
+        vector<char> buffer_;
+        size_t used_;
+        size_t emitted_;
+        bool ok_;
+        Encoding encoding_;
+        unique_ptr<Compressor> compressor_;
+    };
+} // namespace html_writer
+
+#endif // HTML_WRITER_H
@@ -0,0 +1,189 @@
+#include <vector>
+#include <string>
+#include <set>
+#include <map>
+#include <algorithm>
+#include "incremental_analyzer.h"
+
+using namespace std;
+
+incremental_analyzer::Analysis::Analysis(const pattern_grid::Grid& grid, const string& pattern, pattern_analyzer::DirectionSet directions)
+    : grid_(grid), pattern_(pattern), directions_(directions & pattern_analyzer::ALL_DIRECTIONS),
+      candidates_(static_cast<size_t>(grid.rows()) * grid.cols(), 0),
+      accepted_(static_cast<size_t>(grid.rows()) * grid.cols(), 0), count_(0) {
+    for (int d = 0; d < pattern_analyzer::DIRECTION_COUNT; ++d) {
+        row_step_[d] = col_step_[d] = 0;
+        pattern_analyzer::direction_step(pattern_analyzer::direction_code(d), row_step_[d], col_step_[d]);
+    }
+
+    // Full search once, with the usual greedy selection over the candidates in visiting order
+    vector<pattern_analyzer::PatternLocation> locations = pattern_analyzer::find_locations(grid_, pattern_, directions_);
+    pattern_grid::OccupancyBitset occupied(grid_.rows(), grid_.cols());
+    for (const auto& loc : locations) {
+        int d = 0;
+        while (pattern_analyzer::direction_code(d) != loc.direction) ++d;
+        size_t cell = static_cast<size_t>(loc.row) * grid_.cols() + loc.col;
+        candidates_[cell] |= 1u << d;
+
+        bool free = true;
+        for (int k = 0; k < loc.length && free; ++k) {
+            free = !occupied.test(loc.row + k * row_step_[d], loc.col + k * col_step_[d]);
+        }
+        if (free) {
+            pattern_analyzer::occupy(occupied, loc);
+            accepted_[cell] |= 1u << d;
+            ++count_;
+        }
+    }
+}
+
+pattern_analyzer::PatternLocation incremental_analyzer::Analysis::location(Key k) const {
+    int d = static_cast<int>(k % pattern_analyzer::DIRECTION_COUNT);
+    Key cell = k / pattern_analyzer::DIRECTION_COUNT;
+    return {static_cast<int>(cell / grid_.cols()), static_cast<int>(cell % grid_.cols()), pattern_analyzer::direction_code(d),
+            static_cast<int>(pattern_.length())};
+}
+
+// True if the whole pattern fits and reads correctly from (r, c) in direction d
+bool incremental_analyzer::Analysis::matches_at(int r, int c, int d) const {
+    int m = pattern_.length();
+    if (!inside(r, c) || !inside(r + (m - 1) * row_step_[d], c + (m - 1) * col_step_[d])) {
+        return false;
+    }
+    for (int k = 0; k < m; ++k) {
+        if (grid_.at(r + k * row_step_[d], c + k * col_step_[d]) != pattern_[k]) return false;
+    }
+    return true;
+}
+
+bool incremental_analyzer::Analysis::is_candidate(Key k) const {
+    return (candidates_[k / pattern_analyzer::DIRECTION_COUNT] >> (k % pattern_analyzer::DIRECTION_COUNT)) & 1;
+}
+
+bool incremental_analyzer::Analysis::is_accepted(Key k) const {
+    return (accepted_[k / pattern_analyzer::DIRECTION_COUNT] >> (k % pattern_analyzer::DIRECTION_COUNT)) & 1;
+}
+
+// Calls visit with every other candidate that shares a cell with candidate k (some more than once).
+// Stops and returns false as soon as visit returns false.
+template <typename Visit>
+bool incremental_analyzer::Analysis::for_each_overlap(Key k, Visit visit) const {
+    pattern_analyzer::PatternLocation loc = location(k);
+    int d = static_cast<int>(k % pattern_analyzer::DIRECTION_COUNT);
+    int m = pattern_.length();
+    for (int i = 0; i < m; ++i) {
+        int r = loc.row + i * row_step_[d];
+        int c = loc.col + i * col_step_[d];
+        for (int e = 0; e < pattern_analyzer::DIRECTION_COUNT; ++e) {
+            if (!(directions_ & (1u << e))) continue;
+            // Candidates in direction e that cover (r, c) start up to m - 1 steps back from it
+            for (int j = 0; j < m; ++j) {
+                int sr = r - j * row_step_[e];
+                int sc = c - j * col_step_[e];
+                if (!inside(sr, sc)) break;
+                Key other = key(sr, sc, e);
+                if (other != k && is_candidate(other) && !visit(other)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// True if a candidate visited before k that shares a cell with it is accepted
+bool incremental_analyzer::Analysis::blocked(Key k) const {
+    return !for_each_overlap(k, [&](Key other) { return !(other < k && is_accepted(other)); });
+}
+
+bool incremental_analyzer::Analysis::apply(const vector<CellEdit>& edits, Delta& delta) {
+    delta.added.clear();
+    delta.removed.clear();
+    for (const CellEdit& edit : edits) {
+        if (!inside(edit.row, edit.col)) return false;
+    }
+
+    // Every candidate position whose span crosses a changed cell has to be checked again
+    int m = pattern_.length();
+    vector<Key> touched;
+    for (const CellEdit& edit : edits) {
+        if (grid_.at(edit.row, edit.col) == edit.value) continue;
+        grid_.at(edit.row, edit.col) = edit.value;
+        for (int d = 0; d < pattern_analyzer::DIRECTION_COUNT && m > 0; ++d) {
+            if (!(directions_ & (1u << d))) continue;
+            for (int j = 0; j < m; ++j) {
+                int sr = edit.row - j * row_step_[d];
+                int sc = edit.col - j * col_step_[d];
+                if (!inside(sr, sc)) break;
+                touched.push_back(key(sr, sc, d));
+            }
+        }
+    }
+    sort(touched.begin(), touched.end());
+    touched.erase(unique(touched.begin(), touched.end()), touched.end());
+
+    set<Key> pending;          // Candidates whose decision has to be made again, taken in visiting order
+    map<Key, bool> was_accepted; // State before this call of every candidate whose decision changed
+    auto set_accepted = [&](Key k, bool accept) {
+        was_accepted.insert(make_pair(k, !accept));
+        accepted_[k / pattern_analyzer::DIRECTION_COUNT] ^= 1u << (k % pattern_analyzer::DIRECTION_COUNT);
+        count_ += accept ? 1 : -1;
+    };
+    // A changed decision can only change the decisions of overlapping candidates visited after it
+    auto recheck_later_overlaps = [&](Key k) {
+        for_each_overlap(k, [&](Key other) {
+            if (other > k) pending.insert(other);
+            return true;
+        });
+    };
+
+    for (Key k : touched) {
+        pattern_analyzer::PatternLocation loc = location(k);
+        int d = static_cast<int>(k % pattern_analyzer::DIRECTION_COUNT);
+        bool now = matches_at(loc.row, loc.col, d);
+        if (now == is_candidate(k)) continue;
+        if (now) {
+            candidates_[k / pattern_analyzer::DIRECTION_COUNT] |= 1u << d;
+            pending.insert(k);
+        } else {
+            if (is_accepted(k)) {
+                set_accepted(k, false);
+                recheck_later_overlaps(k);
+            }
+            candidates_[k / pattern_analyzer::DIRECTION_COUNT] &= ~(1u << d);
+        }
+    }
+
+    // Candidates are decided in visiting order, so every decision a candidate depends on is final
+    // by the time it is taken out
+    while (!pending.empty()) {
+        Key k = *pending.begin();
+        pending.erase(pending.begin());
+        if (!is_candidate(k)) continue;
+        bool accept = !blocked(k);
+        if (accept != is_accepted(k)) {
+            set_accepted(k, accept);
+            recheck_later_overlaps(k);
+        }
+    }
+
+    for (const auto& entry : was_accepted) {
+        bool now = is_candidate(entry.first) && is_accepted(entry.first);
+        if (now != entry.second) {
+            (now ? delta.added : delta.removed).push_back(location(entry.first));
+        }
+    }
+    return true;
+}
+
+pattern_analyzer::AnalysisResult incremental_analyzer::Analysis::result() const {
+    pattern_analyzer::AnalysisResult result;
+    result.occupied = pattern_grid::OccupancyBitset(grid_.rows(), grid_.cols());
+    for (size_t cell = 0; cell < accepted_.size(); ++cell) {
+        for (unsigned bits = accepted_[cell]; bits; bits &= bits - 1) {
+            pattern_analyzer::PatternLocation loc = location(static_cast<Key>(cell) * pattern_analyzer::DIRECTION_COUNT + __builtin_ctz(bits));
+            pattern_analyzer::occupy(result.occupied, loc);
+            result.locations.push_back(loc);
+        }
+    }
+    result.count = result.locations.size();
+    return result;
+}
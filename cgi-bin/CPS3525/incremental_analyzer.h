@@ -0,0 +1,77 @@
+#ifndef INCREMENTAL_ANALYZER_H
+#define INCREMENTAL_ANALYZER_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "pattern_grid.h"
+#include "pattern_analyzer.h"
+
+using namespace std;
+
+// Namespace for re-analyzing a grid that is edited a few cells at a time (e.g. in a puzzle editor).
+// The first analysis is a normal full search; after that, an edit costs time in proportion to the
+// matches it touches and to the decisions that change, not to the size of the grid.
+namespace incremental_analyzer {
+
+    // New contents of one cell
+    struct CellEdit {
+        int row;
+        int col;
+        char value;
+    };
+
+    // Accepted occurrences that an edit added or removed, each list in reading order
+    struct Delta {
+        vector<pattern_analyzer::PatternLocation> added;
+        vector<pattern_analyzer::PatternLocation> removed;
+    };
+
+    // One pattern on one grid. Every match (the candidate index) and the matches the non-sharing rule
+    // accepted are kept one bit per cell and direction. An edit re-checks only the candidates that
+    // cross an edited cell, then re-runs the greedy selection from the first affected candidate in
+    // visiting order; a decision is re-made only if a match sharing a cell with it changed before it,
+    // so the pass stops where the old and new selections agree again.
+    class Analysis {
+    public:
+        Analysis(const pattern_grid::Grid& grid, const string& pattern,
+                 pattern_analyzer::DirectionSet directions = pattern_analyzer::HORIZONTAL_VERTICAL);
+
+        // Writes the edits into the grid (in order, so a cell edited twice keeps the last value) and
+        // updates the selection. Returns false and changes nothing if an edit is outside the grid.
+        bool apply(const vector<CellEdit>& edits, Delta& delta);
+
+        int count() const { return count_; }
+        const pattern_grid::Grid& grid() const { return grid_; }
+        const string& pattern() const { return pattern_; }
+        pattern_analyzer::DirectionSet directions() const { return directions_; }
+
+        // The same result analyze_pattern would give for the current grid (built by a pass over every cell)
+        pattern_analyzer::AnalysisResult result() const;
+
+    private:
+        // A candidate, as its position in visiting order: (first cell in reading order) * 8 + direction bit
+        typedef long long Key;
+
+        Key key(int r, int c, int d) const { return (static_cast<Key>(r) * grid_.cols() + c) * pattern_analyzer::DIRECTION_COUNT + d; }
+        pattern_analyzer::PatternLocation location(Key k) const;
+        bool inside(int r, int c) const { return r >= 0 && r < grid_.rows() && c >= 0 && c < grid_.cols(); }
+        bool matches_at(int r, int c, int d) const;
+        bool is_candidate(Key k) const;
+        bool is_accepted(Key k) const;
+        bool blocked(Key k) const;
+        template <typename Visit>
+        bool for_each_overlap(Key k, Visit visit) const;
+
+        pattern_grid::Grid grid_;
+        string pattern_;
+        pattern_analyzer::DirectionSet directions_;
+        int row_step_[pattern_analyzer::DIRECTION_COUNT];
+        int col_step_[pattern_analyzer::DIRECTION_COUNT];
+        vector<uint8_t> candidates_; // Per cell: bit d set if the pattern matches from here in direction d
+        vector<uint8_t> accepted_;   // Per cell: bit d set if that match is accepted
+        int count_;
+    };
+} // namespace incremental_analyzer
+
+#endif // INCREMENTAL_ANALYZER_H
@@ -0,0 +1,539 @@
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "match_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MATCH_KERNEL_X86 1
+#endif
+
+using namespace std;
+
+// Marks position i in the hit bitmask
+static inline void set_hit(vector<uint64_t>& hits, int i) {
+    hits[i / 64] |= 1ULL << (i % 64);
+}
+
+// Kernels are instantiated for each pattern length M from 2 to 8 (MAX_FIXED_LENGTH), where the
+// length is a compile-time constant and the pattern fits in one 64-bit word; M = 0 is the generic
+// version for any length, which reads m at run time.
+static const int MAX_FIXED_LENGTH = 8;
+
+// Reads W bytes as one unsigned integer (W = 2, 4 or 8); unaligned loads are fine here
+template <int W>
+static inline uint64_t load_word(const char* p) {
+    if (W == 2) { uint16_t v; memcpy(&v, p, 2); return v; }
+    if (W == 4) { uint32_t v; memcpy(&v, p, 4); return v; }
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+// Pattern of compile-time length M packed for the candidate check: the largest word of W <= M bytes
+// from its start and another one ending at its last byte. Two overlapping loads of the same width
+// cover every length from W to 2W without reading outside the candidate.
+template <int M>
+struct PackedPattern {
+    static const int W = M >= 8 ? 8 : M >= 4 ? 4 : 2;
+    uint64_t head;
+    uint64_t tail;
+
+    explicit PackedPattern(const char* pattern) : head(load_word<W>(pattern)), tail(load_word<W>(pattern + M - W)) {}
+
+    bool matches(const char* candidate) const {
+        return load_word<W>(candidate) == head && (M == W || load_word<W>(candidate + M - W) == tail);
+    }
+};
+
+// The same check for any length: first and last bytes, then the middle
+struct GenericPattern {
+    const char* pattern;
+    int m;
+
+    bool matches(const char* candidate) const {
+        return candidate[0] == pattern[0] && candidate[m - 1] == pattern[m - 1] &&
+               memcmp(candidate + 1, pattern + 1, m > 2 ? m - 2 : 0) == 0;
+    }
+};
+
+template <int M>
+struct PatternFor { typedef PackedPattern<M> type; static type make(const char* pattern, int) { return type(pattern); } };
+template <>
+struct PatternFor<0> { typedef GenericPattern type; static type make(const char* pattern, int m) { return {pattern, m}; } };
+
+template <int M>
+static void find_all_scalar(const char* text, int n, const char* pattern, int m, vector<uint64_t>& hits, int from) {
+    if (M == 0) {
+        GenericPattern needle = {pattern, m};
+        for (int i = from; i <= n - m; ++i) {
+            if (needle.matches(text + i)) {
+                set_hit(hits, i);
+            }
+        }
+        return;
+    }
+    // Short patterns: slide a 64-bit window over the text one byte at a time and compare its low
+    // M bytes with the pattern packed the same way (first character in the highest byte)
+    const uint64_t mask = M >= 8 ? ~0ULL : (1ULL << (8 * (M % 8))) - 1;
+    uint64_t packed = 0;
+    for (int k = 0; k < M; ++k) packed = (packed << 8) | static_cast<unsigned char>(pattern[k]);
+    uint64_t window = 0;
+    for (int j = from; j < n; ++j) {
+        window = (window << 8) | static_cast<unsigned char>(text[j]);
+        if (j - from >= M - 1 && (window & mask) == packed) {
+            set_hit(hits, j - M + 1);
+        }
+    }
+}
+
+// Verifies the candidates in mask (bit b means position base + b) and records the real hits.
+// Candidates already match on the first and last bytes, which settles length 2 on its own.
+template <int M, typename Pattern>
+static inline void verify_candidates(uint32_t mask, int base, const char* text, const Pattern& needle, vector<uint64_t>& hits) {
+    while (mask) {
+        int i = base + __builtin_ctz(mask);
+        if (M == 2 || needle.matches(text + i)) {
+            set_hit(hits, i);
+        }
+        mask &= mask - 1;
+    }
+}
+
+#ifdef MATCH_KERNEL_X86
+template <int M>
+__attribute__((target("sse2")))
+static void find_all_sse2(const char* text, int n, const char* pattern, int m, vector<uint64_t>& hits) {
+    if (M != 0) m = M;
+    const typename PatternFor<M>::type needle = PatternFor<M>::make(pattern, m);
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[m - 1]);
+    int i = 0;
+    // Both loads must stay inside the text: the second one reads up to text[i + m - 1 + 15]
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + m - 1));
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last));
+        verify_candidates<M>(static_cast<uint32_t>(_mm_movemask_epi8(eq)), i, text, needle, hits);
+    }
+    find_all_scalar<M>(text, n, pattern, m, hits, i);
+}
+
+template <int M>
+__attribute__((target("avx2")))
+static void find_all_avx2(const char* text, int n, const char* pattern, int m, vector<uint64_t>& hits) {
+    if (M != 0) m = M;
+    const typename PatternFor<M>::type needle = PatternFor<M>::make(pattern, m);
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[m - 1]);
+    int i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + m - 1));
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last));
+        verify_candidates<M>(static_cast<uint32_t>(_mm256_movemask_epi8(eq)), i, text, needle, hits);
+    }
+    find_all_scalar<M>(text, n, pattern, m, hits, i);
+}
+#endif
+
+// Row-by-row search along several steps (find_all_steps). The vector kernels handle the start
+// columns where every step stays inside the grid horizontally; the cells near the left and right
+// edges are checked one at a time.
+
+// True if pattern[0, m) reads along step from (r, c)
+static inline bool matches_along(const match_kernel::GridText& grid, int r, int c, const char* pattern, int m, match_kernel::Step step) {
+    int last_c = c + (m - 1) * step.col;
+    if (last_c < 0 || last_c >= grid.cols) return false;
+    const char* cell = grid.base + static_cast<ptrdiff_t>(r) * grid.stride + c;
+    ptrdiff_t delta = static_cast<ptrdiff_t>(step.row) * grid.stride + step.col;
+    for (int k = 0; k < m; ++k, cell += delta) {
+        if (*cell != pattern[k]) return false;
+    }
+    return true;
+}
+
+static void find_steps_scalar(const match_kernel::GridText& grid, int r, const char* pattern, int m,
+                              const match_kernel::Step* steps, const bool* reaches, int step_count,
+                              vector<uint64_t>* hits, int c_begin, int c_end) {
+    const char* row = grid.base + static_cast<ptrdiff_t>(r) * grid.stride;
+    for (int c = c_begin; c < c_end; ++c) {
+        if (row[c] != pattern[0]) continue;
+        for (int d = 0; d < step_count; ++d) {
+            if (reaches[d] && matches_along(grid, r, c, pattern, m, steps[d])) set_hit(hits[d], c);
+        }
+    }
+}
+
+// ORs a block's width (16 or 32) hit bits into hits starting at bit c
+static inline void set_hits(vector<uint64_t>& hits, int c, uint32_t mask, int width) {
+    int shift = c % 64;
+    hits[c / 64] |= static_cast<uint64_t>(mask) << shift;
+    if (shift + width > 64) {
+        hits[c / 64 + 1] |= static_cast<uint64_t>(mask) >> (64 - shift);
+    }
+}
+
+// Which steps can fit the whole pattern below or above row r, and the start columns
+// [lo, hi) where all of those fit horizontally as well
+static void plan_row(const match_kernel::GridText& grid, int r, int m, const match_kernel::Step* steps, int step_count,
+                     bool* reaches, int& lo, int& hi) {
+    lo = 0;
+    hi = grid.cols;
+    for (int d = 0; d < step_count; ++d) {
+        int last_r = r + (m - 1) * steps[d].row;
+        reaches[d] = last_r >= 0 && last_r < grid.rows;
+        if (reaches[d]) {
+            lo = max(lo, -(m - 1) * steps[d].col);
+            hi = min(hi, grid.cols - (m - 1) * steps[d].col);
+        }
+    }
+}
+
+static void find_all_steps_scalar(const match_kernel::GridText& grid, int r, const char* pattern, int m,
+                                  const match_kernel::Step* steps, int step_count, vector<uint64_t>* hits) {
+    bool reaches[match_kernel::MAX_STEPS];
+    int lo, hi;
+    plan_row(grid, r, m, steps, step_count, reaches, lo, hi);
+    find_steps_scalar(grid, r, pattern, m, steps, reaches, step_count, hits, 0, grid.cols);
+}
+
+#ifdef MATCH_KERNEL_X86
+__attribute__((target("sse2")))
+static void find_all_steps_sse2(const match_kernel::GridText& grid, int r, const char* pattern, int m,
+                                const match_kernel::Step* steps, int step_count, vector<uint64_t>* hits) {
+    bool reaches[match_kernel::MAX_STEPS];
+    int lo, hi;
+    plan_row(grid, r, m, steps, step_count, reaches, lo, hi);
+    const char* row = grid.base + static_cast<ptrdiff_t>(r) * grid.stride;
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    int c = lo;
+    for (; c + 16 <= hi; c += 16) {
+        __m128i eq_first = _mm_cmpeq_epi8(first, _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + c)));
+        if (_mm_movemask_epi8(eq_first) == 0) continue;
+        for (int d = 0; d < step_count; ++d) {
+            if (!reaches[d]) continue;
+            ptrdiff_t delta = static_cast<ptrdiff_t>(steps[d].row) * grid.stride + steps[d].col;
+            const char* cell = row + c;
+            __m128i eq = eq_first;
+            uint32_t mask = _mm_movemask_epi8(eq);
+            for (int k = 1; k < m && mask; ++k) {
+                cell += delta;
+                eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_set1_epi8(pattern[k]), _mm_loadu_si128(reinterpret_cast<const __m128i*>(cell))));
+                mask = _mm_movemask_epi8(eq);
+            }
+            if (mask) set_hits(hits[d], c, mask, 16);
+        }
+    }
+    find_steps_scalar(grid, r, pattern, m, steps, reaches, step_count, hits, 0, min(lo, grid.cols));
+    find_steps_scalar(grid, r, pattern, m, steps, reaches, step_count, hits, max(c, lo), grid.cols);
+}
+
+__attribute__((target("avx2")))
+static void find_all_steps_avx2(const match_kernel::GridText& grid, int r, const char* pattern, int m,
+                                const match_kernel::Step* steps, int step_count, vector<uint64_t>* hits) {
+    bool reaches[match_kernel::MAX_STEPS];
+    int lo, hi;
+    plan_row(grid, r, m, steps, step_count, reaches, lo, hi);
+    const char* row = grid.base + static_cast<ptrdiff_t>(r) * grid.stride;
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    int c = lo;
+    for (; c + 32 <= hi; c += 32) {
+        __m256i eq_first = _mm256_cmpeq_epi8(first, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + c)));
+        if (_mm256_testz_si256(eq_first, eq_first)) continue;
+        for (int d = 0; d < step_count; ++d) {
+            if (!reaches[d]) continue;
+            ptrdiff_t delta = static_cast<ptrdiff_t>(steps[d].row) * grid.stride + steps[d].col;
+            const char* cell = row + c;
+            __m256i eq = eq_first;
+            bool any = true;
+            for (int k = 1; k < m && any; ++k) {
+                cell += delta;
+                eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(_mm256_set1_epi8(pattern[k]), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cell))));
+                any = !_mm256_testz_si256(eq, eq);
+            }
+            if (any) set_hits(hits[d], c, static_cast<uint32_t>(_mm256_movemask_epi8(eq)), 32);
+        }
+    }
+    find_steps_scalar(grid, r, pattern, m, steps, reaches, step_count, hits, 0, min(lo, grid.cols));
+    find_steps_scalar(grid, r, pattern, m, steps, reaches, step_count, hits, max(c, lo), grid.cols);
+}
+#endif
+
+typedef void (*KernelFn)(const char*, int, const char*, int, vector<uint64_t>&);
+typedef void (*StepsFn)(const match_kernel::GridText&, int, const char*, int, const match_kernel::Step*, int, vector<uint64_t>*);
+
+template <int M>
+static void find_all_scalar_entry(const char* text, int n, const char* pattern, int m, vector<uint64_t>& hits) {
+    find_all_scalar<M>(text, n, pattern, m, hits, 0);
+}
+
+// Kernels of one instruction set indexed by pattern length; lengths without a specialization use the generic one
+struct KernelChoice {
+    KernelFn by_length[MAX_FIXED_LENGTH + 1];
+    StepsFn steps;
+    const char* name;
+};
+
+template <template <int> class Kernel>
+struct KernelTable {
+    static KernelChoice make(StepsFn steps, const char* name) {
+        return {{Kernel<0>::fn, Kernel<0>::fn, Kernel<2>::fn, Kernel<3>::fn, Kernel<4>::fn,
+                 Kernel<5>::fn, Kernel<6>::fn, Kernel<7>::fn, Kernel<8>::fn}, steps, name};
+    }
+};
+
+template <int M> struct ScalarKernel { static constexpr KernelFn fn = find_all_scalar_entry<M>; };
+template <int M> constexpr KernelFn ScalarKernel<M>::fn;
+#ifdef MATCH_KERNEL_X86
+template <int M> struct Sse2Kernel { static constexpr KernelFn fn = find_all_sse2<M>; };
+template <int M> constexpr KernelFn Sse2Kernel<M>::fn;
+template <int M> struct Avx2Kernel { static constexpr KernelFn fn = find_all_avx2<M>; };
+template <int M> constexpr KernelFn Avx2Kernel<M>::fn;
+#endif
+
+// Picks the widest kernel the CPU supports; evaluated once per process
+static KernelChoice choose_kernel() {
+#ifdef MATCH_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return KernelTable<Avx2Kernel>::make(find_all_steps_avx2, "avx2");
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return KernelTable<Sse2Kernel>::make(find_all_steps_sse2, "sse2");
+    }
+#endif
+    return KernelTable<ScalarKernel>::make(find_all_steps_scalar, "scalar");
+}
+
+static const KernelChoice& kernel() {
+    static const KernelChoice choice = choose_kernel();
+    return choice;
+}
+
+void match_kernel::find_all(const char* text, int n, const char* pattern, int m, vector<uint64_t>& hits) {
+    hits.assign((static_cast<size_t>(n) + 63) / 64, 0);
+    if (m <= 0 || m > n) {
+        return;
+    }
+    kernel().by_length[m <= MAX_FIXED_LENGTH ? m : 0](text, n, pattern, m, hits);
+}
+
+void match_kernel::find_all_steps(const GridText& grid, int r, const char* pattern, int m,
+                                  const Step* steps, int step_count, vector<uint64_t>* hits) {
+    for (int d = 0; d < step_count; ++d) {
+        hits[d].assign((static_cast<size_t>(grid.cols) + 63) / 64, 0);
+    }
+    if (m <= 0 || r < 0 || r >= grid.rows) {
+        return;
+    }
+    kernel().steps(grid, r, pattern, m, steps, step_count, hits);
+}
+
+const char* match_kernel::active_kernel() {
+    return kernel().name;
+}
+
+bool match_kernel::all_uppercase(const char* text, size_t n) {
+    size_t i = 0;
+#ifdef __SSE2__
+    // Shift 'A'-'Z' down to 0-25; a byte is in range exactly when min(byte, 25) leaves it unchanged
+    const __m128i base = _mm_set1_epi8('A');
+    const __m128i span = _mm_set1_epi8('Z' - 'A');
+    for (; i + 16 <= n; i += 16) {
+        __m128i shifted = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i)), base);
+        __m128i in_range = _mm_cmpeq_epi8(_mm_min_epu8(shifted, span), shifted);
+        if (_mm_movemask_epi8(in_range) != 0xFFFF) {
+            return false;
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        if (text[i] < 'A' || text[i] > 'Z') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Code of cell i of a 5-bit stream; the next byte is read only when the code reaches into it
+static inline unsigned packed_code(const unsigned char* packed, size_t i) {
+    size_t bit = i * 5;
+    unsigned value = packed[bit / 8] >> (bit % 8);
+    if (bit % 8 > 3) {
+        value |= packed[bit / 8 + 1] << (8 - bit % 8);
+    }
+    return value & 31;
+}
+
+static bool unpack_letters_scalar(const unsigned char* packed, size_t first_cell, size_t n, char* out) {
+    bool valid = true;
+    for (size_t i = 0; i < n; ++i) {
+        unsigned code = packed_code(packed, first_cell + i);
+        valid &= code <= 'Z' - 'A';
+        out[i] = static_cast<char>('A' + code);
+    }
+    return valid;
+}
+
+#ifdef MATCH_KERNEL_X86
+// Every 8 cells start on a byte boundary and take 5 bytes. Each block of 16 cells is shuffled so
+// that every code's two bytes land in a 16-bit lane of its own, multiplied up to bits 11-15 of the
+// lane (the multiplier depends only on the code's bit offset, which repeats every 8 cells),
+// shifted down and packed back to bytes.
+__attribute__((target("ssse3")))
+static bool unpack_letters_ssse3(const unsigned char* packed, size_t packed_bytes, size_t first_cell, size_t n, char* out) {
+    size_t i = min(n, (8 - first_cell % 8) % 8); // Cells before the first byte boundary
+    if (!unpack_letters_scalar(packed, first_cell, i, out)) {
+        return false;
+    }
+    const __m128i low_cells = _mm_setr_epi8(0, 1, 0, 1, 1, 2, 1, 2, 2, 3, 3, 4, 3, 4, 4, 5);
+    const __m128i high_cells = _mm_setr_epi8(5, 6, 5, 6, 6, 7, 6, 7, 7, 8, 8, 9, 8, 9, 9, 10);
+    const __m128i lift = _mm_setr_epi16(1 << 11, 1 << 6, 1 << 9, 1 << 4, 1 << 7, 1 << 10, 1 << 5, 1 << 8);
+    const __m128i max_code = _mm_set1_epi8('Z' - 'A');
+    const __m128i letter_a = _mm_set1_epi8('A');
+    __m128i invalid = _mm_setzero_si128();
+    // A block uses 10 bytes but the load reads 16, which must stay inside packed
+    for (size_t byte = (first_cell + i) / 8 * 5; i + 16 <= n && byte + 16 <= packed_bytes; i += 16, byte += 10) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + byte));
+        __m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(bytes, low_cells), lift), 11);
+        __m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(bytes, high_cells), lift), 11);
+        __m128i codes = _mm_packus_epi16(low, high);
+        invalid = _mm_or_si128(invalid, _mm_cmpgt_epi8(codes, max_code));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_add_epi8(codes, letter_a));
+    }
+    if (_mm_movemask_epi8(invalid) != 0) {
+        return false;
+    }
+    return unpack_letters_scalar(packed, first_cell + i, n - i, out + i);
+}
+
+// The SSSE3 steps on both 128-bit lanes at once: the lanes take 16 cells each, from ten bytes apart
+__attribute__((target("avx2")))
+static bool unpack_letters_avx2(const unsigned char* packed, size_t packed_bytes, size_t first_cell, size_t n, char* out) {
+    size_t i = min(n, (8 - first_cell % 8) % 8);
+    if (!unpack_letters_scalar(packed, first_cell, i, out)) {
+        return false;
+    }
+    const __m256i low_cells = _mm256_setr_epi8(0, 1, 0, 1, 1, 2, 1, 2, 2, 3, 3, 4, 3, 4, 4, 5,
+                                               0, 1, 0, 1, 1, 2, 1, 2, 2, 3, 3, 4, 3, 4, 4, 5);
+    const __m256i high_cells = _mm256_setr_epi8(5, 6, 5, 6, 6, 7, 6, 7, 7, 8, 8, 9, 8, 9, 9, 10,
+                                                5, 6, 5, 6, 6, 7, 6, 7, 7, 8, 8, 9, 8, 9, 9, 10);
+    const __m256i lift = _mm256_setr_epi16(1 << 11, 1 << 6, 1 << 9, 1 << 4, 1 << 7, 1 << 10, 1 << 5, 1 << 8,
+                                           1 << 11, 1 << 6, 1 << 9, 1 << 4, 1 << 7, 1 << 10, 1 << 5, 1 << 8);
+    const __m256i max_code = _mm256_set1_epi8('Z' - 'A');
+    const __m256i letter_a = _mm256_set1_epi8('A');
+    __m256i invalid = _mm256_setzero_si256();
+    for (size_t byte = (first_cell + i) / 8 * 5; i + 32 <= n && byte + 10 + 16 <= packed_bytes; i += 32, byte += 20) {
+        const unsigned char* p = packed + byte;
+        __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+                                                _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 10)), 1);
+        __m256i low = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_shuffle_epi8(bytes, low_cells), lift), 11);
+        __m256i high = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_shuffle_epi8(bytes, high_cells), lift), 11);
+        __m256i codes = _mm256_packus_epi16(low, high); // Packs within each lane, so the cells stay in order
+        invalid = _mm256_or_si256(invalid, _mm256_cmpgt_epi8(codes, max_code));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi8(codes, letter_a));
+    }
+    if (_mm256_movemask_epi8(invalid) != 0) {
+        return false;
+    }
+    return unpack_letters_ssse3(packed, packed_bytes, first_cell + i, n - i, out + i);
+}
+#endif
+
+typedef bool (*UnpackFn)(const unsigned char* packed, size_t packed_bytes, size_t first_cell, size_t n, char* out);
+
+static bool unpack_letters_portable(const unsigned char* packed, size_t, size_t first_cell, size_t n, char* out) {
+    return unpack_letters_scalar(packed, first_cell, n, out);
+}
+
+// Picks the widest unpacker the CPU supports; evaluated once per process
+static UnpackFn choose_unpack() {
+#ifdef MATCH_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return unpack_letters_avx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return unpack_letters_ssse3;
+    }
+#endif
+    return unpack_letters_portable;
+}
+
+bool match_kernel::unpack_letters(const unsigned char* packed, size_t packed_bytes, size_t first_cell, size_t n, char* out) {
+    static const UnpackFn unpack = choose_unpack();
+    return unpack(packed, packed_bytes, first_cell, n, out);
+}
+
+const int CHECKSUM_LANES = 8;
+
+// Adds one 32-byte group to the lanes' Fletcher pairs
+static inline void checksum_group(const unsigned char* group, uint64_t* sum, uint64_t* weighted) {
+    for (int l = 0; l < CHECKSUM_LANES; ++l) {
+        uint32_t word;
+        memcpy(&word, group + 4 * l, 4);
+        sum[l] += word;
+        weighted[l] += sum[l];
+    }
+}
+
+// Whole groups of data[0, n) from group i on, then the zero-padded rest
+static void checksum_scalar(const unsigned char* data, size_t n, size_t i, uint64_t* sum, uint64_t* weighted) {
+    for (; i + 32 <= n; i += 32) {
+        checksum_group(data + i, sum, weighted);
+    }
+    if (i < n) {
+        unsigned char last[32] = {0};
+        memcpy(last, data + i, n - i);
+        checksum_group(last, sum, weighted);
+    }
+}
+
+#ifdef MATCH_KERNEL_X86
+// Lanes 0-3 and 4-7 are each one vector of 64-bit sums, widened from the two halves of a 32-byte load
+__attribute__((target("avx2")))
+static void checksum_avx2(const unsigned char* data, size_t n, uint64_t* sum, uint64_t* weighted) {
+    __m256i sum_low = _mm256_setzero_si256(), sum_high = _mm256_setzero_si256();
+    __m256i weighted_low = _mm256_setzero_si256(), weighted_high = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        sum_low = _mm256_add_epi64(sum_low, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(words)));
+        sum_high = _mm256_add_epi64(sum_high, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(words, 1)));
+        weighted_low = _mm256_add_epi64(weighted_low, sum_low);
+        weighted_high = _mm256_add_epi64(weighted_high, sum_high);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum), sum_low);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum + 4), sum_high);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(weighted), weighted_low);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(weighted + 4), weighted_high);
+    checksum_scalar(data, n, i, sum, weighted);
+}
+#endif
+
+uint64_t match_kernel::checksum(const unsigned char* data, size_t n, uint64_t seed) {
+    uint64_t sum[CHECKSUM_LANES] = {0};
+    uint64_t weighted[CHECKSUM_LANES] = {0};
+#ifdef MATCH_KERNEL_X86
+    static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    if (avx2) {
+        checksum_avx2(data, n, sum, weighted);
+    } else {
+        checksum_scalar(data, n, 0, sum, weighted);
+    }
+#else
+    checksum_scalar(data, n, 0, sum, weighted);
+#endif
+    // Multiply-rotate folding (the XXH64 primes), so that every lane's pair moves every bit of the result
+    uint64_t h = seed ^ 0x27D4EB2F165667C5ULL;
+    for (int l = 0; l < CHECKSUM_LANES; ++l) {
+        h = (h ^ sum[l]) * 0x9E3779B185EBCA87ULL;
+        h = (h << 31) | (h >> 33);
+        h = (h ^ weighted[l]) * 0xC2B2AE3D27D4EB4FULL;
+        h = (h << 27) | (h >> 37);
+    }
+    return h ^ n;
+}
@@ -0,0 +1,78 @@
+#ifndef MATCH_KERNEL_H
+#define MATCH_KERNEL_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Namespace for the low-level substring scanning used by the pattern finders
+namespace match_kernel {
+
+    // Finds every (overlapping) start position of pattern[0, m) in text[0, n).
+    // hits is resized to (n + 63) / 64 words and bit i is set when the pattern starts at text[i].
+    // The scan filters positions by the pattern's first and last characters 16 or 32 bytes at a
+    // time (SSE2 / AVX2, picked once at runtime) and only compares the middle on candidates,
+    // so repetitive rows never restart the search from scratch. Patterns of 2 to 8 characters use
+    // kernels compiled for their exact length, which check candidates (and scan without SIMD) by
+    // comparing the pattern packed into an integer with whole 16/32/64-bit windows of the text.
+    void find_all(const char* text, int n, const char* pattern, int m, vector<uint64_t>& hits);
+
+    // Rows x cols characters, row i starting at base + i * stride
+    struct GridText {
+        const char* base;
+        size_t stride;
+        int rows;
+        int cols;
+    };
+
+    // Direction of a match as the move from one of its characters to the next
+    struct Step {
+        int row;
+        int col;
+    };
+    const int MAX_STEPS = 8;
+
+    // Finds every occurrence of pattern[0, m) that starts on row r of grid and reads along any of
+    // steps[0, step_count) (at most MAX_STEPS). hits[d] is resized to (cols + 63) / 64 words and bit
+    // c is set when pattern[k] sits at (r + k * steps[d].row, c + k * steps[d].col) for every k.
+    // Each block of 16 or 32 start cells is compared with the first character once for all steps;
+    // each step then narrows the block's candidates one character at a time, reading row r + k *
+    // steps[d].row at an offset, and stops as soon as none are left. No transposed or diagonal copy
+    // of the grid is needed.
+    void find_all_steps(const GridText& grid, int r, const char* pattern, int m,
+                        const Step* steps, int step_count, vector<uint64_t>* hits);
+
+    // True if every byte of text[0, n) is an uppercase letter 'A'-'Z' (checked 16 bytes at a time with SSE2)
+    bool all_uppercase(const char* text, size_t n);
+
+    // Unpacks cells [first_cell, first_cell + n) of a stream of 5-bit letter codes ('A' = 0 ... 'Z' = 25,
+    // least significant bit first) in packed[0, packed_bytes) into out as 'A'-'Z'; false if a code is
+    // above 25. packed_bytes must cover cell first_cell + n - 1. 32 or 16 cells (20 or 10 bytes) at a
+    // time with AVX2 or SSSE3, picked once at runtime.
+    bool unpack_letters(const unsigned char* packed, size_t packed_bytes, size_t first_cell, size_t n, char* out);
+
+    // Checksum of data[0, n), for telling a damaged upload from a good one: the bytes, zero-padded to
+    // a multiple of 32, are read as little-endian 32-bit words dealt round-robin to 8 lanes; each lane
+    // keeps a Fletcher pair (sum += word, weighted += sum, modulo 2^64), and the pairs are folded into
+    // seed. 32 bytes at a time with AVX2 when the CPU has it.
+    uint64_t checksum(const unsigned char* data, size_t n, uint64_t seed);
+
+    // Name of the implementation find_all dispatches to ("avx2", "sse2" or "scalar")
+    const char* active_kernel();
+
+    // Calls fn(position) for every bit set in hits, in increasing order
+    template <typename Fn>
+    void for_each_hit(const vector<uint64_t>& hits, Fn fn) {
+        for (size_t w = 0; w < hits.size(); ++w) {
+            uint64_t word = hits[w];
+            while (word) {
+                fn(static_cast<int>(w * 64 + __builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+    }
+} // namespace match_kernel
+
+#endif // MATCH_KERNEL_H
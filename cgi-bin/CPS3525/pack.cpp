@@ -0,0 +1,33 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include "get_validate_input.h" // For loading the grid and writing it packed
+
+using namespace std;
+
+// Converts a grid file (text or already packed) to the packed upload format described at
+// get_validate_input::pack_grid: 5 bits per cell and a checksummed header, over a third smaller than
+// the text and parsed without per-character checks. The game accepts either format.
+// Usage: project3_pack IN OUT
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        cerr << "Usage: " << argv[0] << " IN OUT" << endl;
+        return 2;
+    }
+
+    pattern_grid::Grid grid;
+    if (!get_validate_input::load_grid_file(argv[1], grid, cerr)) {
+        return 1;
+    }
+
+    ofstream out(argv[2], ios::binary);
+    out << get_validate_input::pack_grid(grid);
+    out.close();
+    if (!out) {
+        cerr << "Could not write " << argv[2] << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -4,134 +4,603 @@
 #include <map> // Included for potential future use or compatibility.
 #include <algorithm>
 #include <utility> // For std::pair
+#include <functional>
+#include <cstdint>
 #include "pattern_analyzer.h" // Include the updated header file
+#include "match_kernel.h" // Vectorized substring scanning
+#include "pattern_automaton.h" // Multi-pattern scanning
+#include "thread_pool.h" // Band-parallel search on large grids
+#include "request_metrics.h" // Stage timers and counters
+#include "request_arena.h" // Scratch buffers that die with the request
 
 using namespace std;
 // Removed 'using namespace pattern_analyzer;' here to be more explicit and avoid potential issues
 // Instead, use pattern_analyzer:: prefix for functions defined within the namespace.
 
+// Grids with at least this many cells are searched in bands on the shared thread pool
+static size_t parallel_cell_threshold = 1 << 20;
+
+void pattern_analyzer::set_parallel_threshold(size_t cells) {
+    parallel_cell_threshold = cells;
+}
+
+size_t pattern_analyzer::parallel_threshold() {
+    return parallel_cell_threshold;
+}
+
+// Pattern lists shorter than this are searched one pattern at a time with the SIMD kernels. On a
+// 4000 x 4000 random grid with 4-letter patterns the shared automaton caught up at about 48
+// patterns in the deployed build (only match_kernel.cpp optimized) and about 20 with everything at
+// -O2; 32 stays within a third of the faster choice in both.
+static size_t automaton_pattern_threshold = 32;
+
+void pattern_analyzer::set_automaton_threshold(size_t patterns) {
+    automaton_pattern_threshold = patterns;
+}
+
+size_t pattern_analyzer::automaton_threshold() {
+    return automaton_pattern_threshold;
+}
+
+// Splits lines [0, lines) into contiguous bands and calls scan_band(begin, end, state) for each,
+// with one State per band. Bands run on the shared pool when the grid is large enough, otherwise
+// there is a single band on the calling thread. States come back in band order, so concatenating
+// them gives exactly what a serial scan would have produced.
+template <typename State, typename ScanBand>
+static vector<State> scan_in_bands(const pattern_grid::Grid& grid, int lines, ScanBand scan_band) {
+    thread_pool::ThreadPool* pool = nullptr;
+    int bands = 1;
+    if (static_cast<size_t>(grid.rows()) * grid.cols() >= parallel_cell_threshold) {
+        pool = &thread_pool::shared_pool();
+        // A few bands per thread keeps the work balanced when match density varies
+        bands = min(lines, (pool->size() + 1) * 4);
+    }
+
+    vector<State> states(max(bands, 1));
+    if (pool == nullptr || bands <= 1) {
+        scan_band(0, lines, states[0]);
+        return states;
+    }
+    pool->for_each_band(bands, [&](int band) {
+        int begin = static_cast<long long>(lines) * band / bands;
+        int end = static_cast<long long>(lines) * (band + 1) / bands;
+        scan_band(begin, end, states[band]);
+    });
+    return states;
+}
+
+// Appends the per-band location lists in band order
+static vector<pattern_analyzer::PatternLocation> concat_bands(vector<vector<pattern_analyzer::PatternLocation>>& bands) {
+    if (bands.size() == 1) {
+        return std::move(bands[0]);
+    }
+    size_t total = 0;
+    for (const auto& band : bands) total += band.size();
+    vector<pattern_analyzer::PatternLocation> locations;
+    locations.reserve(total);
+    for (const auto& band : bands) {
+        locations.insert(locations.end(), band.begin(), band.end());
+    }
+    return locations;
+}
+
 // Helper function to find overlapping horizontal occurrences and store locations
-vector<pattern_analyzer::PatternLocation> pattern_analyzer::find_horizontal_locations(const vector<string>& grid, const string& pattern) {
+vector<pattern_analyzer::PatternLocation> pattern_analyzer::find_horizontal_locations(const pattern_grid::Grid& grid, const string& pattern) {
     vector<pattern_analyzer::PatternLocation> locations;
-    if (pattern.empty() || grid.empty() || grid[0].empty()) {
+    if (pattern.empty() || grid.empty()) {
         return locations;
     }
 
-    int rows = grid.size();
-    int cols = grid[0].size();
+    int rows = grid.rows();
+    int cols = grid.cols();
     int pattern_len = pattern.length();
 
     if (pattern_len > 0 && pattern_len <= cols) {
-        for (int i = 0; i < rows; ++i) {
-            const string& row_str = grid[i];
-            size_t pos = row_str.find(pattern, 0);
-            // Modified to find overlapping occurrences: advance position by 1
-            while (pos != string::npos) {
-                locations.push_back({i, static_cast<int>(pos), 'H', pattern_len});
-                pos = row_str.find(pattern, pos + 1); // Find next occurrence starting from the next character
-            }
-        }
+        vector<vector<PatternLocation>> bands = scan_in_bands<vector<PatternLocation>>(grid, rows,
+            [&](int begin, int end, vector<PatternLocation>& band_locations) {
+                vector<uint64_t> hits; // Hit bitmask for one row, reused for every row of the band
+                for (int i = begin; i < end; ++i) {
+                    // One pass over the row reports every overlapping occurrence at once
+                    match_kernel::find_all(grid.row(i), cols, pattern.data(), pattern_len, hits);
+                    match_kernel::for_each_hit(hits, [&](int pos) {
+                        band_locations.push_back({i, pos, 'H', pattern_len});
+                    });
+                }
+            });
+        locations = concat_bands(bands);
     }
     return locations;
 }
 
 // Helper function to find overlapping vertical occurrences and store locations
-vector<pattern_analyzer::PatternLocation> pattern_analyzer::find_vertical_locations(const vector<string>& grid, const string& pattern) {
+vector<pattern_analyzer::PatternLocation> pattern_analyzer::find_vertical_locations(const pattern_grid::Grid& grid, const string& pattern) {
     vector<pattern_analyzer::PatternLocation> locations;
-    if (pattern.empty() || grid.empty() || grid[0].empty()) {
+    if (pattern.empty() || grid.empty()) {
         return locations;
     }
 
-    int rows = grid.size();
-    int cols = grid[0].size();
+    int rows = grid.rows();
+    int cols = grid.cols();
     int pattern_len = pattern.length();
 
     if (pattern_len > 0 && pattern_len <= rows) {
-        for (int j = 0; j < cols; ++j) {
-            string col_str = "";
-            for (int i = 0; i < rows; ++i) {
-                col_str += grid[i][j];
+        if (!grid.is_view()) grid.column(0); // Build the transpose before any band reads it
+        vector<vector<PatternLocation>> bands = scan_in_bands<vector<PatternLocation>>(grid, cols,
+            [&](int begin, int end, vector<PatternLocation>& band_locations) {
+                vector<uint64_t> hits; // Hit bitmask for one column, reused for every column of the band
+                pattern_grid::ColumnReader columns(grid); // A view is transposed a strip at a time per band
+                for (int j = begin; j < end; ++j) {
+                    // Columns are contiguous like rows, so this is the same scan as a row
+                    match_kernel::find_all(columns.column(j), rows, pattern.data(), pattern_len, hits);
+                    match_kernel::for_each_hit(hits, [&](int pos) {
+                        band_locations.push_back({pos, j, 'V', pattern_len});
+                    });
+                }
+            });
+        locations = concat_bands(bands);
+    }
+    return locations;
+}
+
+
+// Calls visit(loc) for every horizontal and vertical match in reading order.
+// h_locations is already in reading order (rows top to bottom, columns left to right) and
+// v_locations is column-major, so instead of concatenating and sorting both lists the vertical
+// starts are bucketed by row with a counting pass and merged with the horizontal ones row by row.
+// When a horizontal and a vertical match start on the same cell the horizontal one goes first.
+// The bucket arrays come from the thread's arena and are released on return.
+template <typename Locations, typename Visit>
+static void for_each_in_reading_order(int rows, const Locations& h_locations, const Locations& v_locations, Visit visit) {
+    request_arena::Scope scratch;
+
+    // Bucket the vertical starts by row; scanning columns in order keeps each bucket sorted by column
+    request_arena::Vector<int> row_start(rows + 1, 0);
+    for (const auto& loc : v_locations) {
+        row_start[loc.row + 1]++;
+    }
+    for (int r = 0; r < rows; ++r) {
+        row_start[r + 1] += row_start[r];
+    }
+    request_arena::Vector<int> v_by_row(v_locations.size()); // Indices into v_locations, grouped by row
+    {
+        request_arena::Vector<int> fill_pos(row_start.begin(), row_start.end() - 1);
+        for (size_t i = 0; i < v_locations.size(); ++i) {
+            v_by_row[fill_pos[v_locations[i].row]++] = i;
+        }
+    }
+
+    // Merge the two streams in reading order, one row at a time
+    size_t h = 0;
+    for (int r = 0; r < rows; ++r) {
+        int v = row_start[r];
+        int v_end = row_start[r + 1];
+        while (h < h_locations.size() && h_locations[h].row == r) {
+            while (v < v_end && v_locations[v_by_row[v]].col < h_locations[h].col) {
+                visit(v_locations[v_by_row[v++]]);
             }
+            visit(h_locations[h++]);
+        }
+        while (v < v_end) {
+            visit(v_locations[v_by_row[v++]]);
+        }
+    }
+}
+
+// Applies the non-sharing rule to a set of overlapping matches: every horizontal and vertical
+// match is visited in reading order and accepted only if none of its cells are already taken
+// by a previously accepted match.
+template <typename Locations>
+static pattern_analyzer::AnalysisResult select_non_sharing(int rows, int cols, const Locations& h_locations, const Locations& v_locations) {
+    pattern_analyzer::AnalysisResult result;
 
-            size_t pos = col_str.find(pattern, 0);
-            // Modified to find overlapping occurrences: advance position by 1
-            while (pos != string::npos) {
-                locations.push_back({static_cast<int>(pos), j, 'V', pattern_len});
-                pos = col_str.find(pattern, pos + 1); // Find next occurrence starting from the next character
+    // Packed bitset to track occupied cells
+    result.occupied = pattern_grid::OccupancyBitset(rows, cols);
+    pattern_grid::OccupancyBitset& occupied = result.occupied;
+
+    // Accepts loc if none of its cells are taken yet (not sharing characters with previously processed valid matches)
+    for_each_in_reading_order(rows, h_locations, v_locations, [&](const pattern_analyzer::PatternLocation& loc) {
+        if (loc.direction == 'H') {
+            if (!occupied.any_horizontal(loc.row, loc.col, loc.length)) {
+                occupied.set_horizontal(loc.row, loc.col, loc.length);
+                result.locations.push_back(loc);
+            }
+        } else { // direction == 'V'
+            if (!occupied.any_vertical(loc.row, loc.col, loc.length)) {
+                occupied.set_vertical(loc.row, loc.col, loc.length);
+                result.locations.push_back(loc);
             }
         }
+    });
+
+    result.count = result.locations.size();
+    return result;
+}
+
+pattern_analyzer::AnalysisResult pattern_analyzer::select_horizontal_vertical(int rows, int cols, const vector<PatternLocation>& h_locations,
+                                                                              const vector<PatternLocation>& v_locations) {
+    return select_non_sharing(rows, cols, h_locations, v_locations);
+}
+
+// Location code and step of each direction, indexed by its bit number in Direction. This is also
+// the order in which matches starting on the same cell are visited.
+struct DirectionInfo {
+    char code;
+    int row_step;
+    int col_step;
+};
+static const DirectionInfo DIRECTION_TABLE[pattern_analyzer::DIRECTION_COUNT] = {
+    {'H', 0, 1}, {'V', 1, 0}, {'h', 0, -1}, {'v', -1, 0},
+    {'D', 1, 1}, {'d', -1, -1}, {'A', -1, 1}, {'a', 1, -1}
+};
+
+// Bit number of a direction code, or pattern_analyzer::DIRECTION_COUNT if the code is unknown
+static int direction_index(char code) {
+    for (int d = 0; d < pattern_analyzer::DIRECTION_COUNT; ++d) {
+        if (DIRECTION_TABLE[d].code == code) return d;
     }
-    return locations;
+    return pattern_analyzer::DIRECTION_COUNT;
 }
 
+char pattern_analyzer::direction_code(int d) {
+    return d >= 0 && d < DIRECTION_COUNT ? DIRECTION_TABLE[d].code : '\0';
+}
 
-// Counts overlapping occurrences that don't share characters between horizontal and vertical matches
-int pattern_analyzer::count_pattern_occurrences(const vector<string>& grid, const string& pattern) {
-    if (pattern.empty() || grid.empty() || grid[0].empty()) {
-        return 0;
+bool pattern_analyzer::direction_step(char direction, int& row_step, int& col_step) {
+    int d = direction_index(direction);
+    if (d == DIRECTION_COUNT) {
+        return false;
     }
+    row_step = DIRECTION_TABLE[d].row_step;
+    col_step = DIRECTION_TABLE[d].col_step;
+    return true;
+}
 
-    int rows = grid.size();
-    int cols = grid[0].size();
-    int pattern_len = pattern.length();
+// Horizontal and vertical spans (either way) are word ranges in the bitset; diagonals go cell by cell
+void pattern_analyzer::occupy(pattern_grid::OccupancyBitset& occupied, const PatternLocation& loc) {
+    switch (loc.direction) {
+        case 'H': occupied.set_horizontal(loc.row, loc.col, loc.length); return;
+        case 'V': occupied.set_vertical(loc.row, loc.col, loc.length); return;
+        case 'h': occupied.set_horizontal(loc.row, loc.col - loc.length + 1, loc.length); return;
+        case 'v': occupied.set_vertical(loc.row - loc.length + 1, loc.col, loc.length); return;
+    }
+    int row_step, col_step;
+    if (!direction_step(loc.direction, row_step, col_step)) return;
+    for (int k = 0; k < loc.length; ++k) {
+        int r = loc.row + k * row_step;
+        int c = loc.col + k * col_step;
+        if (r >= 0 && r < occupied.rows() && c >= 0 && c < occupied.cols()) occupied.set(r, c);
+    }
+}
+
+// True if none of the cells of loc is taken
+static bool is_free(const pattern_grid::OccupancyBitset& occupied, const pattern_analyzer::PatternLocation& loc) {
+    switch (loc.direction) {
+        case 'H': return !occupied.any_horizontal(loc.row, loc.col, loc.length);
+        case 'V': return !occupied.any_vertical(loc.row, loc.col, loc.length);
+        case 'h': return !occupied.any_horizontal(loc.row, loc.col - loc.length + 1, loc.length);
+        case 'v': return !occupied.any_vertical(loc.row - loc.length + 1, loc.col, loc.length);
+    }
+    int row_step = 0, col_step = 0;
+    pattern_analyzer::direction_step(loc.direction, row_step, col_step);
+    for (int k = 0; k < loc.length; ++k) {
+        if (occupied.test(loc.row + k * row_step, loc.col + k * col_step)) return false;
+    }
+    return true;
+}
+
+// Every match of pattern in the given directions, in the order the non-sharing rule visits them:
+// reading order of the first cell, then Direction order. Rows are searched in bands, each row in
+// all directions at once; a row's hit masks are then walked column by column.
+static vector<pattern_analyzer::PatternLocation> find_in_directions(const pattern_grid::Grid& grid, const string& pattern,
+                                                                    pattern_analyzer::DirectionSet directions) {
+    match_kernel::Step steps[match_kernel::MAX_STEPS];
+    char codes[match_kernel::MAX_STEPS];
+    int step_count = 0;
+    for (int d = 0; d < pattern_analyzer::DIRECTION_COUNT; ++d) {
+        if (directions & (1u << d)) {
+            steps[step_count] = {DIRECTION_TABLE[d].row_step, DIRECTION_TABLE[d].col_step};
+            codes[step_count++] = DIRECTION_TABLE[d].code;
+        }
+    }
+    match_kernel::GridText text = {grid.row(0), grid.stride(), grid.rows(), grid.cols()};
+    int m = pattern.length();
+
+    vector<vector<pattern_analyzer::PatternLocation>> bands = scan_in_bands<vector<pattern_analyzer::PatternLocation>>(grid, grid.rows(),
+        [&](int begin, int end, vector<pattern_analyzer::PatternLocation>& band_locations) {
+            vector<uint64_t> hits[match_kernel::MAX_STEPS]; // Reused for every row of the band
+            for (int r = begin; r < end; ++r) {
+                match_kernel::find_all_steps(text, r, pattern.data(), m, steps, step_count, hits);
+                for (size_t w = 0; w < hits[0].size(); ++w) {
+                    uint64_t any = 0;
+                    for (int d = 0; d < step_count; ++d) any |= hits[d][w];
+                    for (; any; any &= any - 1) {
+                        int c = static_cast<int>(w * 64 + __builtin_ctzll(any));
+                        for (int d = 0; d < step_count; ++d) {
+                            if ((hits[d][w] >> (c % 64)) & 1) band_locations.push_back({r, c, codes[d], m});
+                        }
+                    }
+                }
+            }
+        });
+    return concat_bands(bands);
+}
 
-    if (pattern_len == 0) return 0;
+vector<pattern_analyzer::PatternLocation> pattern_analyzer::find_locations(const pattern_grid::Grid& grid, const string& pattern, DirectionSet directions) {
+    directions &= ALL_DIRECTIONS;
+    if (pattern.empty() || grid.empty() || directions == 0) {
+        return vector<PatternLocation>();
+    }
+    return find_in_directions(grid, pattern, directions);
+}
+
+// The non-sharing rule for candidates that are already in visiting order
+static pattern_analyzer::AnalysisResult select_in_order(int rows, int cols, const vector<pattern_analyzer::PatternLocation>& candidates) {
+    pattern_analyzer::AnalysisResult result;
+    result.occupied = pattern_grid::OccupancyBitset(rows, cols);
+    for (const auto& loc : candidates) {
+        if (is_free(result.occupied, loc)) {
+            pattern_analyzer::occupy(result.occupied, loc);
+            result.locations.push_back(loc);
+        }
+    }
+    result.count = result.locations.size();
+    return result;
+}
+
+// analyze_pattern for direction sets other than right and down
+static pattern_analyzer::AnalysisResult analyze_in_directions(const pattern_grid::Grid& grid, const string& pattern,
+                                                              pattern_analyzer::DirectionSet directions) {
+    vector<pattern_analyzer::PatternLocation> candidates;
+    {
+        request_metrics::ScopedTimer timer(request_metrics::SEARCH_H); // All directions come from the row scan
+        candidates = find_in_directions(grid, pattern, directions);
+    }
+    request_metrics::add(request_metrics::CANDIDATES, candidates.size());
+
+    request_metrics::ScopedTimer timer(request_metrics::SELECT);
+    pattern_analyzer::AnalysisResult result = select_in_order(grid.rows(), grid.cols(), candidates);
+    request_metrics::add(request_metrics::ACCEPTED, result.count);
+    return result;
+}
+
+// Runs the search once and keeps the accepted occurrences, their count and the occupied cells
+pattern_analyzer::AnalysisResult pattern_analyzer::analyze_pattern(const pattern_grid::Grid& grid, const string& pattern, DirectionSet directions) {
+    if (pattern.empty() || grid.empty() || (directions & ALL_DIRECTIONS) == 0) {
+        return AnalysisResult();
+    }
+    if (directions != HORIZONTAL_VERTICAL) {
+        return analyze_in_directions(grid, pattern, directions & ALL_DIRECTIONS);
+    }
 
     // Call helper functions to find ALL overlapping locations
-    vector<PatternLocation> h_locations = pattern_analyzer::find_horizontal_locations(grid, pattern);
-    vector<PatternLocation> v_locations = pattern_analyzer::find_vertical_locations(grid, pattern);
+    vector<PatternLocation> h_locations, v_locations;
+    {
+        request_metrics::ScopedTimer timer(request_metrics::SEARCH_H);
+        h_locations = pattern_analyzer::find_horizontal_locations(grid, pattern);
+    }
+    {
+        request_metrics::ScopedTimer timer(request_metrics::SEARCH_V);
+        v_locations = pattern_analyzer::find_vertical_locations(grid, pattern);
+    }
+    request_metrics::add(request_metrics::CANDIDATES, h_locations.size() + v_locations.size());
 
-    vector<PatternLocation> all_locations;
-    all_locations.insert(all_locations.end(), h_locations.begin(), h_locations.end());
-    all_locations.insert(all_locations.end(), v_locations.begin(), v_locations.end());
+    request_metrics::ScopedTimer timer(request_metrics::SELECT);
+    AnalysisResult result = select_non_sharing(grid.rows(), grid.cols(), h_locations, v_locations);
+    request_metrics::add(request_metrics::ACCEPTED, result.count);
+    return result;
+}
 
-    // Sort locations to process them in a consistent order (reading order)
-    sort(all_locations.begin(), all_locations.end());
+// Analyzes several patterns with one pass over the rows and one over the columns.
+// Raw matches for all patterns come out of a single Aho-Corasick scan; the non-sharing
+// rule is then applied to each pattern on its own, exactly as analyze_pattern would.
+// Below automaton_threshold() patterns each one is analyzed on its own instead, which is faster.
+vector<pattern_analyzer::AnalysisResult> pattern_analyzer::analyze_patterns(const pattern_grid::Grid& grid, const vector<string>& patterns, DirectionSet directions) {
+    vector<AnalysisResult> results(patterns.size());
+    if (patterns.empty() || grid.empty() || (directions & ALL_DIRECTIONS) == 0) {
+        return results;
+    }
 
-    // Use a boolean grid to track occupied cells
-    vector<vector<bool>> occupied(rows, vector<bool>(cols, false));
-    int valid_count = 0;
+    int rows = grid.rows();
+    int cols = grid.cols();
 
-    for (const auto& loc : all_locations) {
-        bool can_occupy = true;
-        // Check if the cells for this occurrence are already occupied
-        if (loc.direction == 'H') {
-            for (int i = 0; i < loc.length; ++i) {
-                // Ensure bounds are checked
-                if (loc.col + i < cols && occupied[loc.row][loc.col + i]) {
-                    can_occupy = false;
-                    break;
-                }
+    // Patterns the automaton can hold (non-empty, 'A'-'Z' only); any other pattern cannot match a
+    // grid of uppercase letters and keeps its empty result
+    vector<string> searchable;
+    vector<size_t> searchable_index;
+    for (size_t p = 0; p < patterns.size(); ++p) {
+        if (!patterns[p].empty() && match_kernel::all_uppercase(patterns[p].data(), patterns[p].size())) {
+            searchable.push_back(patterns[p]);
+            searchable_index.push_back(p);
+        }
+    }
+    if (searchable.empty()) {
+        return results;
+    }
+    if (directions != HORIZONTAL_VERTICAL || searchable.size() < automaton_pattern_threshold) {
+        // The row scan covers every direction without a transpose, and a few patterns are scanned
+        // faster by the SIMD kernels one at a time than by the byte-at-a-time automaton, so each
+        // pattern gets its own (band-parallel) pass instead of sharing an automaton
+        for (size_t p = 0; p < searchable.size(); ++p) {
+            results[searchable_index[p]] = analyze_pattern(grid, searchable[p], directions);
+        }
+        return results;
+    }
+    pattern_automaton::Automaton automaton(searchable);
+
+    typedef vector<vector<PatternLocation>> PerPattern; // One location list per searchable pattern
+
+    vector<PerPattern> h_bands, v_bands;
+    {
+        request_metrics::ScopedTimer timer(request_metrics::SEARCH_H);
+        h_bands = scan_in_bands<PerPattern>(grid, rows, [&](int begin, int end, PerPattern& found) {
+            found.resize(searchable.size());
+            for (int i = begin; i < end; ++i) {
+                automaton.scan(grid.row(i), cols, [&](int p, int pos) {
+                    found[p].push_back({i, pos, 'H', static_cast<int>(searchable[p].length())});
+                });
             }
-        } else { // direction == 'V'
-            for (int i = 0; i < loc.length; ++i) {
-                 // Ensure bounds are checked
-                if (loc.row + i < rows && occupied[loc.row + i][loc.col]) {
-                    can_occupy = false;
-                    break;
-                }
+        });
+    }
+    {
+        request_metrics::ScopedTimer timer(request_metrics::SEARCH_V);
+        if (!grid.is_view()) grid.column(0); // Build the transpose before any band reads it
+        v_bands = scan_in_bands<PerPattern>(grid, cols, [&](int begin, int end, PerPattern& found) {
+            found.resize(searchable.size());
+            pattern_grid::ColumnReader columns(grid);
+            for (int j = begin; j < end; ++j) {
+                automaton.scan(columns.column(j), rows, [&](int p, int pos) {
+                    found[p].push_back({pos, j, 'V', static_cast<int>(searchable[p].length())});
+                });
             }
+        });
+    }
+    if (request_metrics::enabled()) {
+        for (const PerPattern& band : h_bands) for (const auto& found : band) request_metrics::add(request_metrics::CANDIDATES, found.size());
+        for (const PerPattern& band : v_bands) for (const auto& found : band) request_metrics::add(request_metrics::CANDIDATES, found.size());
+    }
+
+    // Each pattern's selection is independent of the others
+    request_metrics::ScopedTimer timer(request_metrics::SELECT);
+    // The merged candidate lists are scratch in the arena of whichever thread selects the pattern
+    auto select_pattern = [&](int p) {
+        request_arena::Scope scratch;
+        request_arena::Vector<PatternLocation> h_locations, v_locations;
+        size_t h_total = 0, v_total = 0;
+        for (auto& band : h_bands) h_total += band[p].size();
+        for (auto& band : v_bands) v_total += band[p].size();
+        h_locations.reserve(h_total); // Freed space is not reused in the arena, so size them once
+        v_locations.reserve(v_total);
+        for (auto& band : h_bands) h_locations.insert(h_locations.end(), band[p].begin(), band[p].end());
+        for (auto& band : v_bands) v_locations.insert(v_locations.end(), band[p].begin(), band[p].end());
+        results[searchable_index[p]] = select_non_sharing(rows, cols, h_locations, v_locations);
+    };
+    if (h_bands.size() > 1 && searchable.size() > 1) {
+        thread_pool::shared_pool().for_each_band(searchable.size(), select_pattern);
+    } else {
+        for (size_t p = 0; p < searchable.size(); ++p) {
+            select_pattern(p);
         }
+    }
+    for (const AnalysisResult& result : results) request_metrics::add(request_metrics::ACCEPTED, result.count);
+    return results;
+}
 
-        // If no cells are occupied, this is a valid occurrence (not sharing characters with previously processed valid matches)
-        if (can_occupy) {
-            valid_count++;
-            // Mark the cells as occupied
-            if (loc.direction == 'H') {
-                for (int i = 0; i < loc.length; ++i) {
-                     if (loc.col + i < cols) { // Ensure bounds are checked
-                        occupied[loc.row][loc.col + i] = true;
-                     }
-                }
-            } else { // direction == 'V'
-                for (int i = 0; i < loc.length; ++i) {
-                    if (loc.row + i < rows) { // Ensure bounds are checked
-                        occupied[loc.row + i][loc.col] = true;
-                    }
-                }
+// Counts overlapping occurrences that don't share characters with each other, in any of the directions
+int pattern_analyzer::count_pattern_occurrences(const pattern_grid::Grid& grid, const string& pattern, DirectionSet directions) {
+    return analyze_pattern(grid, pattern, directions).count; // Total count of valid, non-sharing overlapping occurrences
+}
+
+// Occupancy for the rows an accepted match can still reach while the tiled mode walks down the
+// grid: a match starting on row r covers at most rows r to r + length - 1, so only that many
+// rows are kept, in a ring. Each row is padded to whole words so it can be cleared in one go.
+class OccupancyWindow {
+public:
+    OccupancyWindow(int window_rows, int cols)
+        : window_rows_(window_rows), words_per_row_((cols + 63) / 64),
+          bits_(static_cast<size_t>(window_rows) * words_per_row_, 0), current_row_(0) {}
+
+    // Moves the window down so it covers rows [row, row + window_rows); rows above row are forgotten
+    void advance_to(int row) {
+        if (row - current_row_ >= window_rows_) {
+            fill(bits_.begin(), bits_.end(), 0);
+        } else {
+            for (int r = current_row_ + window_rows_; r < row + window_rows_; ++r) {
+                uint64_t* words = slot(r);
+                fill(words, words + words_per_row_, 0);
             }
         }
+        current_row_ = row;
+    }
+
+    bool any_horizontal(int row, int col, int len) {
+        const uint64_t* words = slot(row);
+        for (int c = col; c < col + len; ++c) {
+            if ((words[c / 64] >> (c % 64)) & 1) return true;
+        }
+        return false;
+    }
+
+    bool any_vertical(int row, int col, int len) {
+        for (int r = row; r < row + len; ++r) {
+            if ((slot(r)[col / 64] >> (col % 64)) & 1) return true;
+        }
+        return false;
+    }
+
+    void set_horizontal(int row, int col, int len) {
+        uint64_t* words = slot(row);
+        for (int c = col; c < col + len; ++c) {
+            words[c / 64] |= 1ULL << (c % 64);
+        }
     }
 
-    return valid_count; // Return the total count of valid, non-sharing overlapping occurrences
+    void set_vertical(int row, int col, int len) {
+        for (int r = row; r < row + len; ++r) {
+            slot(r)[col / 64] |= 1ULL << (col % 64);
+        }
+    }
+
+private:
+    uint64_t* slot(int row) { return &bits_[static_cast<size_t>(row % window_rows_) * words_per_row_]; }
+
+    int window_rows_;
+    size_t words_per_row_;
+    vector<uint64_t> bits_;
+    int current_row_;
+};
+
+// Out-of-core version of analyze_pattern. Rows are read band_rows at a time plus a halo of
+// length - 1 rows below, so vertical matches that start in the band are found in full; only
+// the band, its halo and an OccupancyWindow of length rows are in memory at once. Accepted
+// matches are the same, in the same order, as analyze_pattern's.
+bool pattern_analyzer::analyze_pattern_tiled(int rows, int cols, const RowReader& read_rows, const string& pattern,
+                                             int band_rows, const function<void(const PatternLocation&)>& on_accept,
+                                             long long& count) {
+    count = 0;
+    int length = pattern.length();
+    if (rows <= 0 || cols <= 0 || length == 0 || band_rows <= 0) {
+        return rows >= 0 && cols >= 0 && band_rows > 0;
+    }
+
+    OccupancyWindow window(length, cols);
+    for (int band_start = 0; band_start < rows; band_start += band_rows) {
+        int band_length = min(band_rows, rows - band_start);
+        int loaded = min(band_length + length - 1, rows - band_start); // Band plus halo
+        pattern_grid::Grid band(loaded, cols);
+        if (!read_rows(band_start, loaded, band.row(0))) {
+            return false;
+        }
+
+        // Horizontal matches in the halo belong to the next band
+        vector<PatternLocation> h_locations, v_locations;
+        {
+            request_metrics::ScopedTimer timer(request_metrics::SEARCH_H);
+            h_locations = find_horizontal_locations(band, pattern);
+        }
+        while (!h_locations.empty() && h_locations.back().row >= band_length) {
+            h_locations.pop_back();
+        }
+        {
+            request_metrics::ScopedTimer timer(request_metrics::SEARCH_V);
+            v_locations = find_vertical_locations(band, pattern); // All start within the band
+        }
+        request_metrics::add(request_metrics::CANDIDATES, h_locations.size() + v_locations.size());
+
+        request_metrics::ScopedTimer timer(request_metrics::SELECT);
+        for_each_in_reading_order(band_length, h_locations, v_locations, [&](PatternLocation loc) {
+            loc.row += band_start;
+            window.advance_to(loc.row);
+            if (loc.direction == 'H') {
+                if (window.any_horizontal(loc.row, loc.col, loc.length)) return;
+                window.set_horizontal(loc.row, loc.col, loc.length);
+            } else {
+                if (window.any_vertical(loc.row, loc.col, loc.length)) return;
+                window.set_vertical(loc.row, loc.col, loc.length);
+            }
+            ++count;
+            on_accept(loc);
+        });
+    }
+    request_metrics::add(request_metrics::ACCEPTED, count);
+    return true;
 }
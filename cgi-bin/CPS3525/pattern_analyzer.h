@@ -6,16 +6,36 @@
 #include <map> // Included for potential future use or compatibility, though not strictly needed for current core functions.
 #include <utility> // For std::pair
 #include <algorithm> // Included for std::sort
+#include <functional>
+#include <climits> // For INT_MAX
+#include "pattern_grid.h"
 
 using namespace std;
 
 // Namespace to organize pattern analysis related functions
 namespace pattern_analyzer {
 
+    // Directions a match can run in, as bits of a DirectionSet. Each has a location code; a lowercase
+    // code reads the same line as its uppercase one, backwards.
+    enum Direction {
+        RIGHT = 1 << 0,      // 'H'
+        DOWN = 1 << 1,       // 'V'
+        LEFT = 1 << 2,       // 'h'
+        UP = 1 << 3,         // 'v'
+        DOWN_RIGHT = 1 << 4, // 'D'
+        UP_LEFT = 1 << 5,    // 'd'
+        UP_RIGHT = 1 << 6,   // 'A'
+        DOWN_LEFT = 1 << 7   // 'a'
+    };
+    typedef unsigned DirectionSet;
+    const DirectionSet HORIZONTAL_VERTICAL = RIGHT | DOWN; // The game's original rules
+    const DirectionSet ALL_DIRECTIONS = 0xFF;
+    const int DIRECTION_COUNT = 8;
+
     struct PatternLocation {
-        int row;
+        int row;        // Cell of the pattern's first character
         int col;
-        char direction; // 'H' for horizontal, 'V' for vertical
+        char direction; // 'H' for horizontal, 'V' for vertical, or another Direction code
         int length;
 
         // Comparison operator for sorting PatternLocation objects (reading order)
@@ -26,10 +46,92 @@ namespace pattern_analyzer {
             return col < other.col;
         }
     };
-    int count_pattern_occurrences(const vector<string>& grid, const string& pattern);
-    vector<PatternLocation> find_horizontal_locations(const vector<string>& grid, const string& pattern);
-    vector<PatternLocation> find_vertical_locations(const vector<string>& grid, const string& pattern);
-    vector<string> generate_numbered_grid(const vector<string>& grid, const string& pattern);
+
+    // Result of a single search pass over the grid. Holds the accepted (non-sharing)
+    // occurrences in reading order, their count, and the cells those occurrences occupy,
+    // so the count and the numbered view can both be produced without searching again.
+    struct AnalysisResult {
+        vector<PatternLocation> locations; // Accepted occurrences, in reading order
+        int count = 0;                     // Same as locations.size()
+        pattern_grid::OccupancyBitset occupied; // rows x cols, set where an accepted occurrence sits
+    };
+
+    // Location code of the direction with bit number d ('\0' if out of range)
+    char direction_code(int d);
+    // Row and column step of a direction code; false if the code is unknown
+    bool direction_step(char direction, int& row_step, int& col_step);
+
+    // Marks the cells covered by loc
+    void occupy(pattern_grid::OccupancyBitset& occupied, const PatternLocation& loc);
+
+    // Grids with at least this many cells are split into row/column bands and searched on the
+    // shared thread pool; results are identical to the serial search. Set to SIZE_MAX to stay serial.
+    void set_parallel_threshold(size_t cells);
+    size_t parallel_threshold();
+
+    // analyze_patterns shares one automaton scan between the patterns only when there are at least
+    // this many of them; shorter lists are analyzed pattern by pattern. Set to SIZE_MAX to never share.
+    void set_automaton_threshold(size_t patterns);
+    size_t automaton_threshold();
+
+    // Matches in any of the given directions take part in one greedy selection: every match is
+    // visited in reading order of its first cell (ties in Direction order, so H before V) and is
+    // accepted if it shares no cell with a match accepted before it.
+    AnalysisResult analyze_pattern(const pattern_grid::Grid& grid, const string& pattern, DirectionSet directions = HORIZONTAL_VERTICAL);
+    // One result per pattern, in the same order; from automaton_threshold() patterns up the grid is scanned once for all of them.
+    // The grid must hold only 'A'-'Z' (as validated grids do): patterns with any other character get an empty result
+    vector<AnalysisResult> analyze_patterns(const pattern_grid::Grid& grid, const vector<string>& patterns, DirectionSet directions = HORIZONTAL_VERTICAL);
+    // The non-sharing rule over horizontal matches in reading order and vertical matches column by column,
+    // as find_horizontal_locations and find_vertical_locations list them (for searches done another way)
+    AnalysisResult select_horizontal_vertical(int rows, int cols, const vector<PatternLocation>& h_locations,
+                                              const vector<PatternLocation>& v_locations);
+    int count_pattern_occurrences(const pattern_grid::Grid& grid, const string& pattern, DirectionSet directions = HORIZONTAL_VERTICAL);
+    // Every match in the given directions, overlapping or not, in the order the non-sharing rule visits them
+    vector<PatternLocation> find_locations(const pattern_grid::Grid& grid, const string& pattern, DirectionSet directions);
+    vector<PatternLocation> find_horizontal_locations(const pattern_grid::Grid& grid, const string& pattern);
+    vector<PatternLocation> find_vertical_locations(const pattern_grid::Grid& grid, const string& pattern);
+
+    // Cells of one accepted occurrence on one row: columns [col, col + length) of row
+    struct OverlayRun {
+        int row;
+        int col;
+        int length;
+        int occurrence; // Number of the occurrence, counting from 1 in reading order
+    };
+
+    // The numbered view of an analysis, kept as a side table over the original grid instead of a
+    // numbered copy of it: a horizontal occurrence is one run, any other direction one run per cell,
+    // so the table grows with the matched cells (16 bytes a run) rather than with the grid area.
+    class NumberedOverlay {
+    public:
+        // Adds the cells of loc on rows [first_row, last_row) under the given occurrence number
+        void add(const PatternLocation& loc, int occurrence, int first_row = 0, int last_row = INT_MAX);
+        // Puts the runs in reading order, the order the renderer walks them in
+        void sort();
+        void clear() { runs_.clear(); crossing_.clear(); sorted_ = true; }
+        // The runs, once sort has been called
+        const vector<OverlayRun>& runs() const { return runs_; }
+
+    private:
+        static bool reading_order(const OverlayRun& a, const OverlayRun& b);
+
+        vector<OverlayRun> runs_;     // Horizontal runs, then (after sort) all of them
+        vector<OverlayRun> crossing_; // Cells of the other directions, until sort merges them in
+        bool sorted_ = true;          // runs_ is in reading order
+    };
+
+    // The overlay numbering result's occurrences 1, 2, 3, ... in reading order, without searching again
+    NumberedOverlay number_occurrences(const AnalysisResult& result);
+
+    // Copies rows [first_row, first_row + count) of a grid into out (count * cols bytes, no padding); false on failure
+    typedef function<bool(int first_row, int count, char* out)> RowReader;
+
+    // Tiled, out-of-core analyze_pattern for grids too large to hold in memory: the grid is read in
+    // horizontal bands of band_rows rows plus a (pattern length - 1) row halo, and only a sliding
+    // window of occupancy is kept between bands. on_accept gets every accepted occurrence, in the same
+    // order analyze_pattern would list them. Horizontal and vertical matches only. Returns false if read_rows fails.
+    bool analyze_pattern_tiled(int rows, int cols, const RowReader& read_rows, const string& pattern,
+                               int band_rows, const function<void(const PatternLocation&)>& on_accept, long long& count);
 } // namespace pattern_analyzer
 
 #endif // PATTERN_ANALYZER_H
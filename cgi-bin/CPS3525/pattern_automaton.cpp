@@ -0,0 +1,57 @@
+#include <vector>
+#include <string>
+#include <queue>
+#include "pattern_automaton.h"
+
+using namespace std;
+
+// Builds the trie of all patterns, then fills in failure links breadth first so that
+// every node has a transition for every letter and scanning never backtracks
+pattern_automaton::Automaton::Automaton(const vector<string>& patterns) {
+    nodes_.push_back(Node());
+    nodes_[0].next.fill(-1);
+
+    for (size_t p = 0; p < patterns.size(); ++p) {
+        int state = 0;
+        for (char c : patterns[p]) {
+            int letter = c - 'A';
+            if (nodes_[state].next[letter] == -1) {
+                nodes_[state].next[letter] = nodes_.size();
+                nodes_.push_back(Node());
+                nodes_.back().next.fill(-1);
+            }
+            state = nodes_[state].next[letter];
+        }
+        nodes_[state].has_output = true;
+        nodes_[state].outputs.push_back(p);
+        pattern_lengths_.push_back(patterns[p].length());
+    }
+
+    queue<int> pending;
+    for (int letter = 0; letter < ALPHABET; ++letter) {
+        int child = nodes_[0].next[letter];
+        if (child == -1) {
+            nodes_[0].next[letter] = 0;
+        } else {
+            nodes_[child].fail = 0;
+            pending.push(child);
+        }
+    }
+
+    while (!pending.empty()) {
+        int state = pending.front();
+        pending.pop();
+        int fail = nodes_[state].fail;
+        nodes_[state].dict_link = nodes_[fail].has_output ? fail : nodes_[fail].dict_link;
+
+        for (int letter = 0; letter < ALPHABET; ++letter) {
+            int child = nodes_[state].next[letter];
+            if (child == -1) {
+                nodes_[state].next[letter] = nodes_[fail].next[letter];
+            } else {
+                nodes_[child].fail = nodes_[fail].next[letter];
+                pending.push(child);
+            }
+        }
+    }
+}
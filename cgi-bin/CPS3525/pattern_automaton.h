@@ -0,0 +1,60 @@
+#ifndef PATTERN_AUTOMATON_H
+#define PATTERN_AUTOMATON_H
+
+#include <vector>
+#include <string>
+#include <array>
+
+using namespace std;
+
+// Namespace for the multi-pattern matcher used when several patterns are checked against one grid
+namespace pattern_automaton {
+
+    // Aho-Corasick automaton over the uppercase alphabet A-Z.
+    // Feeding a line through it reports every (overlapping) occurrence of every pattern
+    // in a single left-to-right pass, however many patterns there are.
+    class Automaton {
+    public:
+        // Patterns must be non-empty and contain only 'A'-'Z'; duplicates are allowed
+        explicit Automaton(const vector<string>& patterns);
+
+        size_t pattern_count() const { return pattern_lengths_.size(); }
+
+        // Calls on_match(pattern_index, start) for every occurrence in text[0, n),
+        // in order of the position where the occurrence ends
+        template <typename Fn>
+        void scan(const char* text, int n, Fn on_match) const {
+            int state = 0;
+            for (int i = 0; i < n; ++i) {
+                int letter = text[i] - 'A';
+                if (letter < 0 || letter >= ALPHABET) {
+                    state = 0; // Characters outside A-Z cannot be part of any pattern
+                    continue;
+                }
+                state = nodes_[state].next[letter];
+                // Walk the chain of nodes that end a pattern (this node, then its dictionary suffix links)
+                for (int out = nodes_[state].has_output ? state : nodes_[state].dict_link; out > 0; out = nodes_[out].dict_link) {
+                    for (int p : nodes_[out].outputs) {
+                        on_match(p, i - pattern_lengths_[p] + 1);
+                    }
+                }
+            }
+        }
+
+    private:
+        static const int ALPHABET = 26;
+
+        struct Node {
+            array<int, ALPHABET> next; // Complete transition table once built
+            int fail = 0;              // Longest proper suffix that is also a trie node
+            int dict_link = 0;         // Nearest suffix node that ends a pattern (0 if none)
+            bool has_output = false;
+            vector<int> outputs;       // Pattern indices ending exactly at this node
+        };
+
+        vector<Node> nodes_;
+        vector<int> pattern_lengths_;
+    };
+} // namespace pattern_automaton
+
+#endif // PATTERN_AUTOMATON_H
@@ -0,0 +1,252 @@
+#include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#include "pattern_grid.h"
+
+using namespace std;
+
+// Side length of the square tiles used when transposing; a tile of source rows and
+// destination columns both stay in L1 while it is copied
+static const int TRANSPOSE_TILE = 64;
+
+pattern_grid::Grid::Grid() : rows_(0), cols_(0), stride_(0), base_(nullptr), columns_ready_(false) {}
+
+pattern_grid::Grid::Grid(int rows, int cols, char fill)
+    : rows_(rows), cols_(cols), stride_(cols), cells_(static_cast<size_t>(rows) * cols, fill), columns_ready_(false) {
+    base_ = cells_.data();
+}
+
+pattern_grid::Grid::Grid(shared_ptr<const char> storage, const char* first_row, int rows, int cols, size_t stride)
+    : rows_(rows), cols_(cols), stride_(stride), base_(first_row), storage_(std::move(storage)), columns_ready_(false) {}
+
+pattern_grid::Grid::Grid(const Grid& other)
+    : rows_(other.rows_), cols_(other.cols_), stride_(other.stride_), cells_(other.cells_),
+      storage_(other.storage_), columns_ready_(false) {
+    base_ = storage_ ? other.base_ : cells_.data();
+}
+
+pattern_grid::Grid::Grid(Grid&& other)
+    : rows_(other.rows_), cols_(other.cols_), stride_(other.stride_), cells_(std::move(other.cells_)),
+      base_(other.base_), storage_(std::move(other.storage_)),
+      columns_(std::move(other.columns_)), columns_ready_(other.columns_ready_) {
+    other.rows_ = other.cols_ = 0;
+    other.stride_ = 0;
+    other.base_ = nullptr;
+    other.columns_ready_ = false;
+}
+
+pattern_grid::Grid& pattern_grid::Grid::operator=(const Grid& other) {
+    if (this != &other) {
+        rows_ = other.rows_;
+        cols_ = other.cols_;
+        stride_ = other.stride_;
+        cells_ = other.cells_;
+        storage_ = other.storage_;
+        base_ = storage_ ? other.base_ : cells_.data();
+        columns_ready_ = false;
+    }
+    return *this;
+}
+
+pattern_grid::Grid& pattern_grid::Grid::operator=(Grid&& other) {
+    if (this != &other) {
+        rows_ = other.rows_;
+        cols_ = other.cols_;
+        stride_ = other.stride_;
+        cells_ = std::move(other.cells_);
+        base_ = other.base_;
+        storage_ = std::move(other.storage_);
+        columns_ = std::move(other.columns_);
+        columns_ready_ = other.columns_ready_;
+        other.rows_ = other.cols_ = 0;
+        other.stride_ = 0;
+        other.base_ = nullptr;
+        other.columns_ready_ = false;
+    }
+    return *this;
+}
+
+// Gives a view its own compact copy of the cells before they are modified
+void pattern_grid::Grid::copy_view() {
+    cells_.resize(static_cast<size_t>(rows_) * cols_);
+    for (int r = 0; r < rows_; ++r) {
+        memcpy(&cells_[static_cast<size_t>(r) * cols_], base_ + r * stride_, cols_);
+    }
+    stride_ = cols_;
+    base_ = cells_.data();
+    storage_.reset();
+}
+
+void pattern_grid::Grid::set_row(int r, const char* src) {
+    memcpy(row(r), src, cols_);
+}
+
+const char* pattern_grid::Grid::column(int c) const {
+    if (!columns_ready_) {
+        build_columns();
+    }
+    return columns_.data() + static_cast<size_t>(c) * rows_;
+}
+
+void pattern_grid::Grid::build_columns() const {
+    columns_.resize(static_cast<size_t>(rows_) * cols_);
+    copy_columns(0, cols_, columns_.data());
+    columns_ready_ = true;
+}
+
+// Transposes tile by tile so neither the reads nor the writes walk a whole row or column at once
+void pattern_grid::Grid::copy_columns(int first_col, int count, char* out) const {
+    int last_col = first_col + count;
+    for (int r0 = 0; r0 < rows_; r0 += TRANSPOSE_TILE) {
+        int r1 = min(r0 + TRANSPOSE_TILE, rows_);
+        for (int c0 = first_col; c0 < last_col; c0 += TRANSPOSE_TILE) {
+            int c1 = min(c0 + TRANSPOSE_TILE, last_col);
+            for (int r = r0; r < r1; ++r) {
+                const char* src = row(r);
+                for (int c = c0; c < c1; ++c) {
+                    out[static_cast<size_t>(c - first_col) * rows_ + r] = src[c];
+                }
+            }
+        }
+    }
+}
+
+const int pattern_grid::ColumnReader::COLUMN_STRIP;
+
+const char* pattern_grid::ColumnReader::column(int c) {
+    if (!grid_.is_view()) {
+        return grid_.column(c);
+    }
+    if (first_ < 0 || c < first_ || c >= first_ + COLUMN_STRIP) {
+        first_ = c - c % COLUMN_STRIP;
+        int count = min(COLUMN_STRIP, grid_.cols() - first_);
+        strip_.resize(static_cast<size_t>(min(COLUMN_STRIP, grid_.cols())) * grid_.rows());
+        grid_.copy_columns(first_, count, strip_.data());
+    }
+    return strip_.data() + static_cast<size_t>(c - first_) * grid_.rows();
+}
+
+pattern_grid::Grid pattern_grid::from_rows(const vector<string>& lines) {
+    if (lines.empty() || lines[0].empty()) {
+        return Grid();
+    }
+    Grid grid(lines.size(), lines[0].size());
+    for (int r = 0; r < grid.rows(); ++r) {
+        size_t n = min(lines[r].size(), static_cast<size_t>(grid.cols()));
+        memcpy(grid.row(r), lines[r].data(), n);
+    }
+    return grid;
+}
+
+pattern_grid::OccupancyBitset::OccupancyBitset() : rows_(0), cols_(0), by_col_ready_(false) {}
+
+pattern_grid::OccupancyBitset::OccupancyBitset(int rows, int cols)
+    : rows_(rows), cols_(cols),
+      by_row_((static_cast<size_t>(rows) * cols + 63) / 64, 0),
+      by_col_ready_(false) {}
+
+// Fills the column-major bits from the row-major ones, visiting only the set bits
+void pattern_grid::OccupancyBitset::build_by_col() const {
+    by_col_.assign(by_row_.size(), 0);
+    for (size_t w = 0; w < by_row_.size(); ++w) {
+        uint64_t word = by_row_[w];
+        while (word) {
+            size_t bit = w * 64 + __builtin_ctzll(word);
+            size_t col_bit = (bit % cols_) * rows_ + bit / cols_;
+            by_col_[col_bit / 64] |= 1ULL << (col_bit % 64);
+            word &= word - 1;
+        }
+    }
+    by_col_ready_ = true;
+}
+
+bool pattern_grid::OccupancyBitset::test(int r, int c) const {
+    size_t bit = static_cast<size_t>(r) * cols_ + c;
+    return (by_row_[bit / 64] >> (bit % 64)) & 1;
+}
+
+void pattern_grid::OccupancyBitset::set(int r, int c) {
+    size_t row_bit = static_cast<size_t>(r) * cols_ + c;
+    size_t col_bit = static_cast<size_t>(c) * rows_ + r;
+    by_row_[row_bit / 64] |= 1ULL << (row_bit % 64);
+    if (by_col_ready_) {
+        by_col_[col_bit / 64] |= 1ULL << (col_bit % 64);
+    }
+}
+
+// Returns true if any bit in [begin, begin + len) is set, checking whole words where possible
+bool pattern_grid::OccupancyBitset::any_in_range(const vector<uint64_t>& bits, size_t begin, size_t len) {
+    if (len == 0) return false;
+    size_t end = begin + len; // one past the last bit
+    size_t first_word = begin / 64;
+    size_t last_word = (end - 1) / 64;
+    uint64_t head_mask = ~0ULL << (begin % 64);
+    uint64_t tail_mask = ~0ULL >> (63 - (end - 1) % 64);
+
+    if (first_word == last_word) {
+        return (bits[first_word] & head_mask & tail_mask) != 0;
+    }
+    if (bits[first_word] & head_mask) return true;
+    for (size_t w = first_word + 1; w < last_word; ++w) {
+        if (bits[w]) return true;
+    }
+    return (bits[last_word] & tail_mask) != 0;
+}
+
+// Sets every bit in [begin, begin + len), filling whole words where possible
+void pattern_grid::OccupancyBitset::set_range(vector<uint64_t>& bits, size_t begin, size_t len) {
+    if (len == 0) return;
+    size_t end = begin + len;
+    size_t first_word = begin / 64;
+    size_t last_word = (end - 1) / 64;
+    uint64_t head_mask = ~0ULL << (begin % 64);
+    uint64_t tail_mask = ~0ULL >> (63 - (end - 1) % 64);
+
+    if (first_word == last_word) {
+        bits[first_word] |= head_mask & tail_mask;
+        return;
+    }
+    bits[first_word] |= head_mask;
+    for (size_t w = first_word + 1; w < last_word; ++w) {
+        bits[w] = ~0ULL;
+    }
+    bits[last_word] |= tail_mask;
+}
+
+// Spans are clipped to the grid, matching the bounds checks the analyzer has always done
+bool pattern_grid::OccupancyBitset::any_horizontal(int r, int c, int len) const {
+    len = min(len, cols_ - c);
+    if (len <= 0) return false;
+    return any_in_range(by_row_, static_cast<size_t>(r) * cols_ + c, len);
+}
+
+bool pattern_grid::OccupancyBitset::any_vertical(int r, int c, int len) const {
+    len = min(len, rows_ - r);
+    if (len <= 0) return false;
+    if (!by_col_ready_) build_by_col();
+    return any_in_range(by_col_, static_cast<size_t>(c) * rows_ + r, len);
+}
+
+void pattern_grid::OccupancyBitset::set_horizontal(int r, int c, int len) {
+    len = min(len, cols_ - c);
+    if (len <= 0) return;
+    set_range(by_row_, static_cast<size_t>(r) * cols_ + c, len);
+    if (!by_col_ready_) return;
+    for (int i = 0; i < len; ++i) {
+        size_t bit = static_cast<size_t>(c + i) * rows_ + r;
+        by_col_[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+void pattern_grid::OccupancyBitset::set_vertical(int r, int c, int len) {
+    len = min(len, rows_ - r);
+    if (len <= 0) return;
+    if (!by_col_ready_) build_by_col();
+    set_range(by_col_, static_cast<size_t>(c) * rows_ + r, len);
+    for (int i = 0; i < len; ++i) {
+        size_t bit = static_cast<size_t>(r + i) * cols_ + c;
+        by_row_[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
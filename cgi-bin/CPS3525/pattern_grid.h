@@ -0,0 +1,127 @@
+#ifndef PATTERN_GRID_H
+#define PATTERN_GRID_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+// Namespace for the grid storage types shared by the parser, the analyzer and the HTML output
+namespace pattern_grid {
+
+    // Character grid stored in one contiguous row-major buffer.
+    // Row r starts at row(r) and rows are stride() bytes apart.
+    // A grid can also be a read-only view over memory it does not own (e.g. a mapped file, where
+    // the newline after each row is stride padding); storage keeps that memory alive. The first
+    // non-const access copies a view's cells into a buffer of its own.
+    class Grid {
+    public:
+        Grid();
+        Grid(int rows, int cols, char fill = ' ');
+        Grid(shared_ptr<const char> storage, const char* first_row, int rows, int cols, size_t stride);
+        // Copies and moves carry the cells only (a copied view shares its storage); the column cache is rebuilt on demand
+        Grid(const Grid& other);
+        Grid(Grid&& other);
+        Grid& operator=(const Grid& other);
+        Grid& operator=(Grid&& other);
+
+        int rows() const { return rows_; }
+        int cols() const { return cols_; }
+        size_t stride() const { return stride_; }
+        bool empty() const { return rows_ == 0 || cols_ == 0; }
+        bool is_view() const { return static_cast<bool>(storage_); }
+
+        const char* row(int r) const { return base_ + r * stride_; }
+        char* row(int r) { make_writable(); invalidate_columns(); return &cells_[0] + r * stride_; }
+        char at(int r, int c) const { return row(r)[c]; }
+        char& at(int r, int c) { return row(r)[c]; }
+
+        // Copies one row of cols() characters into row r
+        void set_row(int r, const char* src);
+
+        // Column c as rows() contiguous characters, read from a transposed copy of the grid.
+        // The copy is built on first use and kept until the grid is modified, so vertical
+        // searches for any number of patterns share one transpose.
+        const char* column(int c) const;
+
+        // Copies columns [first_col, first_col + count) into out, column first_col + i starting at i * rows()
+        void copy_columns(int first_col, int count, char* out) const;
+
+    private:
+        void invalidate_columns() { columns_ready_ = false; }
+        void build_columns() const;
+        void make_writable() { if (storage_) copy_view(); }
+        void copy_view();
+
+        int rows_;
+        int cols_;
+        size_t stride_;
+        vector<char> cells_;
+        const char* base_;                // Row 0: cells_.data(), or inside storage_ for a view
+        shared_ptr<const char> storage_;  // Set only for views
+        mutable vector<char> columns_; // cols x rows, column c starts at c * rows
+        mutable bool columns_ready_;
+    };
+
+    // Columns one after another as contiguous characters, for scans that walk them in order. A view
+    // (e.g. a mapped file, which can be far larger than memory should hold twice) is transposed a
+    // strip of COLUMN_STRIP columns at a time into a buffer the reader reuses; other grids are read
+    // from their cached transpose, which later searches share. Readers on several threads need the
+    // transpose of a non-view grid built first (grid.column(0)).
+    class ColumnReader {
+    public:
+        static const int COLUMN_STRIP = 256; // A 200 MB mapped grid scanned as fast as with a full transpose
+
+        explicit ColumnReader(const Grid& grid) : grid_(grid), first_(-1) {}
+
+        // Column c; valid until the next call. Cheapest when c only increases.
+        const char* column(int c);
+
+    private:
+        const Grid& grid_;
+        vector<char> strip_; // Up to COLUMN_STRIP columns of rows characters, starting at column first_
+        int first_;
+    };
+
+    // One bit per grid cell, used to track cells taken by accepted occurrences.
+    // Bits are kept both row-major and column-major so a horizontal or vertical
+    // span is always a contiguous bit range that can be tested and set a word at a time.
+    // The column-major copy is only built once a vertical span is checked or set, so searches
+    // that never accept or test a vertical match keep a single bit per cell.
+    class OccupancyBitset {
+    public:
+        OccupancyBitset();
+        OccupancyBitset(int rows, int cols);
+
+        int rows() const { return rows_; }
+        int cols() const { return cols_; }
+
+        bool test(int r, int c) const;
+        // Sets a single cell (for diagonal spans, which neither bit order keeps contiguous)
+        void set(int r, int c);
+
+        bool any_horizontal(int r, int c, int len) const;
+        bool any_vertical(int r, int c, int len) const;
+        void set_horizontal(int r, int c, int len);
+        void set_vertical(int r, int c, int len);
+
+    private:
+        static bool any_in_range(const vector<uint64_t>& bits, size_t begin, size_t len);
+        static void set_range(vector<uint64_t>& bits, size_t begin, size_t len);
+        void build_by_col() const;
+
+        int rows_;
+        int cols_;
+        vector<uint64_t> by_row_;         // bit index r * cols + c
+        mutable vector<uint64_t> by_col_; // bit index c * rows + r, once by_col_ready_
+        mutable bool by_col_ready_;
+    };
+
+    // Builds a Grid from equal-length strings (rows after the first are cut or padded to the first row's width)
+    Grid from_rows(const vector<string>& lines);
+} // namespace pattern_grid
+
+#endif // PATTERN_GRID_H
@@ -0,0 +1,79 @@
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include "request_arena.h"
+
+using namespace std;
+
+// Size of a thread's first chunk; later chunks at least double the previous one
+static const size_t FIRST_CHUNK_BYTES = 64u << 10;
+// reset() keeps at most this much memory for the next request
+static const size_t RETAINED_BYTES = 64u << 20;
+
+request_arena::Arena::Arena() : current_(0), used_(0) {}
+
+void* request_arena::Arena::allocate(size_t bytes, size_t alignment) {
+    for (;;) {
+        if (current_ < chunks_.size()) {
+            Chunk& chunk = chunks_[current_];
+            uintptr_t base = reinterpret_cast<uintptr_t>(chunk.data.get());
+            size_t offset = ((base + used_ + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+            if (offset <= chunk.size && bytes <= chunk.size - offset) {
+                used_ = offset + bytes;
+                return chunk.data.get() + offset;
+            }
+            if (used_ == 0 && current_ + 1 == chunks_.size()) {
+                // An empty last chunk that is too small is replaced rather than skipped
+                chunks_.pop_back();
+            } else {
+                ++current_;
+                used_ = 0;
+                continue;
+            }
+        }
+        size_t last = chunks_.empty() ? FIRST_CHUNK_BYTES / 2 : chunks_.back().size;
+        Chunk chunk;
+        chunk.size = max(max(last * 2, FIRST_CHUNK_BYTES), bytes + alignment);
+        chunk.data.reset(new char[chunk.size]);
+        chunks_.push_back(std::move(chunk));
+        current_ = chunks_.size() - 1;
+        used_ = 0;
+    }
+}
+
+void request_arena::Arena::rewind(const Mark& mark) {
+    if (mark.chunk == 0 && mark.used == 0) {
+        reset();
+        return;
+    }
+    current_ = mark.chunk;
+    used_ = mark.used;
+}
+
+void request_arena::Arena::reset() {
+    current_ = 0;
+    used_ = 0;
+    if (chunks_.size() == 1 && chunks_[0].size <= RETAINED_BYTES) {
+        return;
+    }
+    size_t total = min(capacity(), RETAINED_BYTES);
+    chunks_.clear();
+    if (total > 0) {
+        Chunk chunk;
+        chunk.size = total;
+        chunk.data.reset(new char[chunk.size]);
+        chunks_.push_back(std::move(chunk));
+    }
+}
+
+size_t request_arena::Arena::capacity() const {
+    size_t total = 0;
+    for (const Chunk& chunk : chunks_) total += chunk.size;
+    return total;
+}
+
+request_arena::Arena& request_arena::thread_arena() {
+    static thread_local Arena arena;
+    return arena;
+}
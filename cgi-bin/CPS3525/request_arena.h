@@ -0,0 +1,98 @@
+#ifndef REQUEST_ARENA_H
+#define REQUEST_ARENA_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+using namespace std;
+
+// Namespace for the per-request memory arena. Scratch data that dies with the request (candidate
+// lists, merge buffers) is carved out of a few large chunks instead of coming from the heap one
+// allocation at a time, and is released all at once. Every thread has its own arena, so server
+// workers and pool threads never share one.
+namespace request_arena {
+
+    // Monotonic allocator over a list of chunks. Individual frees do nothing; memory comes back when
+    // the arena is rewound to an earlier mark or reset. Chunks are kept for reuse, so a long-lived
+    // worker reaches a steady state where requests allocate nothing from the heap.
+    class Arena {
+    public:
+        struct Mark {
+            size_t chunk;
+            size_t used;
+        };
+
+        Arena();
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void* allocate(size_t bytes, size_t alignment);
+
+        // Position to rewind to; everything allocated after it is released together
+        Mark mark() const { return {current_, used_}; }
+        void rewind(const Mark& mark);
+
+        // Releases everything. If the last use spilled over several chunks they are merged into one
+        // (up to a limit, so one huge request does not pin its memory for good)
+        void reset();
+
+        size_t capacity() const;
+
+    private:
+        struct Chunk {
+            unique_ptr<char[]> data;
+            size_t size;
+        };
+
+        vector<Chunk> chunks_;
+        size_t current_; // Chunk being filled
+        size_t used_;    // Bytes used in it
+    };
+
+    // The calling thread's arena
+    Arena& thread_arena();
+
+    // Marks the calling thread's arena and rewinds it when the scope ends. Scopes nest: each
+    // releases only what was allocated inside it. Nothing allocated in a scope may outlive it.
+    class Scope {
+    public:
+        Scope() : arena_(thread_arena()), mark_(arena_.mark()) {}
+        ~Scope() { arena_.rewind(mark_); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        Arena& arena() { return arena_; }
+
+    private:
+        Arena& arena_;
+        Arena::Mark mark_;
+    };
+
+    // Standard allocator over an arena (the calling thread's by default). A container using it must
+    // stay on the thread that created it and must not outlive the enclosing Scope.
+    template <typename T>
+    struct Allocator {
+        typedef T value_type;
+
+        Arena* arena;
+
+        Allocator() : arena(&thread_arena()) {}
+        explicit Allocator(Arena& a) : arena(&a) {}
+        template <typename U>
+        Allocator(const Allocator<U>& other) : arena(other.arena) {}
+
+        T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+        void deallocate(T*, size_t) {}
+    };
+
+    template <typename T, typename U>
+    bool operator==(const Allocator<T>& a, const Allocator<U>& b) { return a.arena == b.arena; }
+    template <typename T, typename U>
+    bool operator!=(const Allocator<T>& a, const Allocator<U>& b) { return a.arena != b.arena; }
+
+    template <typename T>
+    using Vector = vector<T, Allocator<T>>;
+} // namespace request_arena
+
+#endif // REQUEST_ARENA_H
@@ -0,0 +1,444 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include "generate_html.h" // For generating HTML output
+#include "get_validate_input.h" // For validating form data
+#include "pattern_analyzer.h" // For analyzing the pattern grid (counting occurrences and numbering)
+#include "result_cache.h" // For reusing results of repeated queries
+#include "grid_index.h" // For answering new patterns on a known grid from its index
+#include "request_metrics.h" // For the render timer and cache hit count
+#include "request_arena.h" // For the request's scratch memory
+#include "request_handler.h"
+
+using namespace std;
+
+// Looks every pattern up in the shared result cache and analyzes only the misses.
+// With PROJECT3_INDEX_DIR set, right/down misses are answered from the grid's position index;
+// otherwise a single pattern uses the SIMD finders and several share one Aho-Corasick scan.
+static vector<pattern_analyzer::AnalysisResult> analyze_with_cache(const pattern_grid::Grid& grid, const vector<string>& patterns,
+                                                                   pattern_analyzer::DirectionSet directions) {
+    result_cache::ResultCache& cache = result_cache::shared_cache();
+    uint64_t grid_hash = result_cache::hash_grid(grid);
+
+    vector<pattern_analyzer::AnalysisResult> analyses(patterns.size());
+    vector<string> missing;
+    vector<size_t> missing_index;
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        if (!cache.lookup(grid_hash, grid.rows(), grid.cols(), patterns[i], directions, analyses[i])) {
+            missing.push_back(patterns[i]);
+            missing_index.push_back(i);
+        }
+    }
+    request_metrics::add(request_metrics::CACHE_HITS, patterns.size() - missing.size());
+
+    vector<pattern_analyzer::AnalysisResult> fresh;
+    grid_index::GridIndex index;
+    if (!missing.empty() && directions == pattern_analyzer::HORIZONTAL_VERTICAL && grid_index::shared_index(grid, grid_hash, index)) {
+        for (const string& pattern : missing) {
+            fresh.push_back(grid_index::analyze_pattern(grid, pattern, index));
+        }
+    } else if (missing.size() == 1) {
+        fresh.push_back(pattern_analyzer::analyze_pattern(grid, missing[0], directions));
+    } else if (!missing.empty()) {
+        fresh = pattern_analyzer::analyze_patterns(grid, missing, directions);
+    }
+    for (size_t i = 0; i < fresh.size(); ++i) {
+        cache.store(grid_hash, grid.rows(), grid.cols(), missing[i], directions, fresh[i]);
+        analyses[missing_index[i]] = std::move(fresh[i]);
+    }
+    return analyses;
+}
+
+// The "render_mode" form field picks the grid layout: "compact" writes each row as one line of
+// text, anything else keeps the one-cell-per-character table
+static bool compact_layout(const get_validate_input::FormInput& input) {
+    map<string, string>::const_iterator mode = input.fields.find("render_mode");
+    return mode != input.fields.end() && get_validate_input::trim(mode->second) == "compact";
+}
+
+pattern_analyzer::DirectionSet request_handler::search_directions(const get_validate_input::FormInput& input) {
+    map<string, string>::const_iterator directions = input.fields.find("directions");
+    bool all = directions != input.fields.end() && get_validate_input::trim(directions->second) == "all";
+    return all ? pattern_analyzer::ALL_DIRECTIONS : pattern_analyzer::HORIZONTAL_VERTICAL;
+}
+
+html_writer::Encoding request_handler::response_encoding(const get_validate_input::FormInput& input) {
+    return compact_layout(input) ? html_writer::negotiate_encoding(input.accept_encoding) : html_writer::IDENTITY;
+}
+
+// Uploads of at least this many bytes are pipelined when pipelining is on; smaller grids are parsed
+// and searched faster than a second thread starts
+static const size_t PIPELINE_MIN_BYTES = 256u << 10;
+// Cells parsed, and then written out, per step of the original grid
+static const size_t PIPELINE_STEP_CELLS = 64u << 10;
+// Cells per band of the search that follows the parser
+static const size_t PIPELINE_BAND_CELLS = 256u << 10;
+
+static bool pipeline_from_environment() {
+    const char* value = getenv("PROJECT3_PIPELINE");
+    return value != nullptr && strcmp(value, "0") != 0 && value[0] != '\0';
+}
+
+static bool pipeline_flag = pipeline_from_environment();
+
+void request_handler::set_pipelined(bool pipelined) {
+    pipeline_flag = pipelined;
+}
+
+bool request_handler::pipelined() {
+    return pipeline_flag;
+}
+
+// What the parser and the search thread of one pipelined page tell each other
+struct PipelineProgress {
+    mutex lock;
+    condition_variable changed;
+    size_t rows_parsed = 0;
+    bool parse_failed = false;
+    // Per pattern: the accepted occurrences found so far, in reading order, and the number of rows
+    // no later occurrence can touch any more
+    vector<vector<pattern_analyzer::PatternLocation>> accepted;
+    vector<int> rows_final;
+    exception_ptr error;
+    // The search thread's timers and counters, read once it is joined
+    request_metrics::Record metrics{};
+};
+
+// The search thread of a pipelined page. Right/down patterns are searched band by band with the tiled
+// analyzer, each band as soon as the parser has passed it; other direction sets wait for the whole grid.
+static void search_behind_parser(const pattern_grid::Grid& grid, const vector<string>& patterns,
+                                 pattern_analyzer::DirectionSet directions, PipelineProgress& progress) {
+    int rows = grid.rows();
+    int cols = grid.cols();
+    // Waits until rows [0, last_row) are parsed; false if parsing failed first
+    auto wait_for_rows = [&](int last_row) {
+        unique_lock<mutex> guard(progress.lock);
+        progress.changed.wait(guard, [&] { return progress.rows_parsed >= static_cast<size_t>(last_row) || progress.parse_failed; });
+        return progress.rows_parsed >= static_cast<size_t>(last_row);
+    };
+    try {
+        for (size_t i = 0; i < patterns.size(); ++i) {
+            vector<pattern_analyzer::PatternLocation> found; // Not handed over yet
+            auto hand_over = [&](int rows_final) {
+                lock_guard<mutex> guard(progress.lock);
+                progress.accepted[i].insert(progress.accepted[i].end(), found.begin(), found.end());
+                progress.rows_final[i] = rows_final;
+                progress.changed.notify_all();
+                found.clear();
+            };
+
+            if (directions == pattern_analyzer::HORIZONTAL_VERTICAL) {
+                // Before a band is read, every occurrence starting above it has been accepted, so
+                // the rows above it are final
+                pattern_analyzer::RowReader read_rows = [&](int first_row, int count, char* out) {
+                    hand_over(first_row);
+                    if (!wait_for_rows(first_row + count)) return false;
+                    for (int r = 0; r < count; ++r) {
+                        memcpy(out + static_cast<size_t>(r) * cols, grid.row(first_row + r), cols);
+                    }
+                    return true;
+                };
+                int band_rows = static_cast<int>(max<size_t>(1, PIPELINE_BAND_CELLS / cols));
+                long long count = 0;
+                if (!pattern_analyzer::analyze_pattern_tiled(rows, cols, read_rows, patterns[i], band_rows,
+                                                             [&](const pattern_analyzer::PatternLocation& loc) { found.push_back(loc); }, count)) {
+                    return; // The parser failed; nobody waits for the rest
+                }
+            } else {
+                if (!wait_for_rows(rows)) return;
+                found = pattern_analyzer::analyze_pattern(grid, patterns[i], directions).locations;
+            }
+            hand_over(rows);
+        }
+    } catch (...) {
+        lock_guard<mutex> guard(progress.lock);
+        progress.error = current_exception();
+        progress.changed.notify_all();
+    }
+}
+
+// search_behind_parser with its own metrics record, left in progress for the request's thread
+static void run_search(const pattern_grid::Grid& grid, const vector<string>& patterns,
+                       pattern_analyzer::DirectionSet directions, PipelineProgress& progress) {
+    request_metrics::begin_request();
+    search_behind_parser(grid, patterns, directions, progress);
+    progress.metrics = request_metrics::current();
+}
+
+// Runs search_behind_parser on its own thread; the destructor stops waiting for rows, joins it and
+// adds its timers and counters to this thread's, so the thread never outlives the grid, also when
+// the page is left early
+class SearchThread {
+public:
+    SearchThread(const pattern_grid::Grid& grid, const vector<string>& patterns, pattern_analyzer::DirectionSet directions,
+                 PipelineProgress& progress)
+        : progress_(progress), thread_(run_search, cref(grid), cref(patterns), directions, ref(progress)) {}
+    ~SearchThread() {
+        {
+            lock_guard<mutex> guard(progress_.lock);
+            progress_.parse_failed = true; // No effect once every row is in
+            progress_.changed.notify_all();
+        }
+        thread_.join();
+        request_metrics::merge(progress_.metrics);
+    }
+
+private:
+    PipelineProgress& progress_;
+    thread thread_;
+};
+
+// The error heading and paragraph for a form that did not validate
+static void write_invalid_input(html_writer::Writer& out) {
+    // If input validation failed, show an error message
+    generate_html::generate_heading(out, "Error: Invalid Input", 2);
+    generate_html::generate_paragraph(out, "There was an issue processing the uploaded file or the form data. Please check the file format and your input. Check the server error log for more details.");
+    // Note: More specific error messages are generated within get_validate_input::validate_form
+}
+
+// Last row a cell of loc is on
+static int last_row_of(const pattern_analyzer::PatternLocation& loc) {
+    int row_step = 0, col_step = 1;
+    pattern_analyzer::direction_step(loc.direction, row_step, col_step);
+    return loc.row + max(0, (loc.length - 1) * row_step);
+}
+
+// The pipelined page body: the same page as write_result_page, but the original grid is written
+// while the upload is still being parsed, a second thread searches the parsed bands behind the
+// parser, and each numbered grid is written band by band as its occurrences become final.
+// An invalid grid line is reported after the rows before it, instead of in place of the grid.
+// The result cache is not consulted, since its key is the hash of the whole grid.
+static void write_pipelined_body(const get_validate_input::FormInput& input, html_writer::Writer& out) {
+    vector<string> guessed_patterns;
+    vector<int> guessed_occurrences;
+    bool convertToNumber;
+    ostringstream validation_messages;
+    pattern_grid::Grid pattern_grid_content;
+    get_validate_input::GridParser parser;
+
+    bool valid = get_validate_input::validate_fields(input, guessed_patterns, guessed_occurrences, convertToNumber, validation_messages);
+    if (valid) {
+        request_metrics::ScopedTimer parse_timer(request_metrics::PARSE);
+        request_metrics::add(request_metrics::BYTES_PARSED, input.pattern_file.size());
+        try {
+            valid = parser.begin(input.pattern_file.data(), input.pattern_file.size(), pattern_grid_content, validation_messages);
+        } catch (const exception& e) {
+            validation_messages << "Exception caught during form data processing: " << e.what() << endl;
+            valid = false;
+        }
+    }
+    if (!valid) {
+        out.raw(validation_messages.str());
+        write_invalid_input(out);
+        return;
+    }
+
+    int rows = pattern_grid_content.rows();
+    int cols = pattern_grid_content.cols();
+    bool compact = compact_layout(input);
+    PipelineProgress progress;
+    progress.accepted.resize(guessed_patterns.size());
+    progress.rows_final.assign(guessed_patterns.size(), 0);
+    SearchThread search(pattern_grid_content, guessed_patterns, request_handler::search_directions(input), progress);
+
+    // Parse the rows a step at a time, each step written out before the next is parsed
+    generate_html::generate_paragraph(out, "Original Pattern Grid:");
+    generate_html::begin_grid(out, compact);
+    size_t step_rows = max<size_t>(1, PIPELINE_STEP_CELLS / cols);
+    while (valid && !parser.all_rows_parsed()) {
+        size_t first_row = parser.rows_parsed();
+        {
+            request_metrics::ScopedTimer parse_timer(request_metrics::PARSE);
+            valid = parser.parse_rows(step_rows, validation_messages);
+        }
+        size_t last_row = parser.rows_parsed();
+        {
+            lock_guard<mutex> guard(progress.lock);
+            progress.rows_parsed = last_row;
+            progress.changed.notify_all();
+        }
+        if (last_row == first_row) break; // The upload ended early; finish() reports the missing rows
+        request_metrics::ScopedTimer render_timer(request_metrics::RENDER);
+        generate_html::generate_grid_rows(out, pattern_grid_content, static_cast<int>(first_row), static_cast<int>(last_row), compact);
+        out.flush();
+    }
+    if (valid) {
+        request_metrics::ScopedTimer parse_timer(request_metrics::PARSE);
+        valid = parser.finish(validation_messages);
+    }
+    generate_html::end_grid(out, compact);
+    if (!valid) {
+        out.raw(validation_messages.str());
+        write_invalid_input(out);
+        return; // search's destructor releases the search thread
+    }
+
+    // Waits until pattern i is final beyond row rows_done, and takes its new occurrences
+    auto wait_for_pattern = [&](size_t i, int rows_done, size_t taken, vector<pattern_analyzer::PatternLocation>& fresh) {
+        unique_lock<mutex> guard(progress.lock);
+        progress.changed.wait(guard, [&] { return progress.rows_final[i] > rows_done || progress.error; });
+        if (progress.error) rethrow_exception(progress.error);
+        fresh.assign(progress.accepted[i].begin() + taken, progress.accepted[i].end());
+        return progress.rows_final[i];
+    };
+
+    if (convertToNumber) {
+        for (size_t i = 0; i < guessed_patterns.size(); ++i) {
+            if (guessed_patterns.size() == 1) {
+                generate_html::generate_paragraph(out, "Pattern Grid with Occurrences Numbered:");
+            } else {
+                generate_html::generate_paragraph(out, "Pattern Grid with Occurrences of \"" + guessed_patterns[i] + "\" Numbered:");
+            }
+            // Only the occurrences that may still reach rows not yet written are kept, each with its
+            // number; every step lays the part of them on the step's rows over the original grid
+            vector<pair<pattern_analyzer::PatternLocation, int>> open_occurrences;
+            pattern_analyzer::NumberedOverlay overlay;
+
+            generate_html::begin_grid(out, compact);
+            size_t numbered = 0;
+            for (int rows_done = 0; rows_done < rows;) {
+                vector<pattern_analyzer::PatternLocation> fresh;
+                int rows_final = wait_for_pattern(i, rows_done, numbered, fresh);
+                request_metrics::ScopedTimer render_timer(request_metrics::RENDER);
+                for (const auto& loc : fresh) {
+                    open_occurrences.push_back(make_pair(loc, static_cast<int>(++numbered)));
+                }
+                overlay.clear();
+                for (const auto& occurrence : open_occurrences) {
+                    overlay.add(occurrence.first, occurrence.second, rows_done, rows_final);
+                }
+                overlay.sort();
+                size_t next_run = 0;
+                generate_html::generate_numbered_rows(out, pattern_grid_content, rows_done, rows_final, compact, overlay, next_run);
+                out.flush();
+                rows_done = rows_final;
+                open_occurrences.erase(remove_if(open_occurrences.begin(), open_occurrences.end(),
+                                                 [&](const pair<pattern_analyzer::PatternLocation, int>& occurrence) {
+                                                     return last_row_of(occurrence.first) < rows_done;
+                                                 }),
+                                       open_occurrences.end());
+            }
+            generate_html::end_grid(out, compact);
+        }
+    }
+
+    // The counts need every pattern searched to the end
+    vector<int> actual_occurrence_counts;
+    for (size_t i = 0; i < guessed_patterns.size(); ++i) {
+        unique_lock<mutex> guard(progress.lock);
+        progress.changed.wait(guard, [&] { return progress.rows_final[i] == rows || progress.error; });
+        if (progress.error) rethrow_exception(progress.error);
+        actual_occurrence_counts.push_back(progress.accepted[i].size()); // Counted as accepted by the search thread
+    }
+
+    request_metrics::ScopedTimer render_timer(request_metrics::RENDER);
+    generate_html::generate_heading(out, "Pattern Search Analysis and Guess Result", 2);
+    if (guessed_patterns.size() == 1) {
+        bool correct = (guessed_occurrences[0] == actual_occurrence_counts[0]);
+        generate_html::generate_result_message(out, correct, guessed_patterns[0], guessed_occurrences[0], actual_occurrence_counts[0]);
+    } else {
+        generate_html::generate_results_table(out, guessed_patterns, guessed_occurrences, actual_occurrence_counts);
+    }
+}
+
+// Writes the whole result page for one submitted form: validation errors, or the grids and
+// the guess results. Shared by the CGI program and the built-in server.
+void request_handler::write_result_page(const get_validate_input::FormInput& input, html_writer::Writer& out) {
+    // Scratch memory taken from this thread's arena during the request is all released here, at once
+    request_arena::Scope request_scope;
+
+    // Output the beginning of the HTML document with a page title
+    generate_html::generate_html_header(out, "Pattern Search Game Result"); // Updated title
+
+    // Compressed pages are built whole: gzip on the writing thread made the pipelined page slower
+    // (5.85 s against 5.19 s for a 16 MB upload shown compact)
+    if (pipelined() && input.pattern_file.size() >= PIPELINE_MIN_BYTES && out.encoding() == html_writer::IDENTITY) {
+        write_pipelined_body(input, out);
+        generate_html::generate_html_footer(out);
+        return;
+    }
+
+    // Variables to store extracted form and file data
+    pattern_grid::Grid pattern_grid_content; // Stores the original pattern grid from the file
+    vector<string> guessed_patterns; // Stores the user's guessed pattern string(s)
+    vector<int> guessed_occurrences; // Stores the user's guessed number of occurrences for each pattern
+    bool convertToNumber; // Stores the state of the 'convert to numbers' checkbox
+
+    // Attempt to validate the form and file data
+    // The validate_form function populates pattern_grid_content, guessed_patterns, guessed_occurrences, and convertToNumber
+    // Validation messages are rare and short, so they are collected in a stream and copied into the page
+    ostringstream validation_messages;
+    bool valid = get_validate_input::validate_form(input, pattern_grid_content, guessed_patterns, guessed_occurrences, convertToNumber, validation_messages);
+    out.raw(validation_messages.str());
+    if (!valid) {
+        write_invalid_input(out);
+    } else {
+        // --- Game Logic: Word Search ---
+
+        // Search the grid once; the counts and the numbered grids all come from these results.
+        // Results already cached for this grid and pattern are reused without searching.
+        vector<pattern_analyzer::AnalysisResult> analyses = analyze_with_cache(pattern_grid_content, guessed_patterns, search_directions(input));
+
+        // The actual non-overlapping occurrences of each guessed pattern in the original grid
+        vector<int> actual_occurrence_counts;
+        for (const auto& analysis : analyses) {
+            actual_occurrence_counts.push_back(analysis.count);
+        }
+
+        // --- Output Results ---
+        request_metrics::ScopedTimer render_timer(request_metrics::RENDER);
+        bool compact = compact_layout(input);
+
+        // Always display the original pattern grid
+        generate_html::generate_paragraph(out, "Original Pattern Grid:"); // Add label for the original grid
+        if (compact) {
+            generate_html::generate_compact_grid(out, pattern_grid_content);
+        } else {
+            generate_html::generate_pattern_table(out, pattern_grid_content);
+        }
+
+        // If convertToNumber is true, generate and display the numbered grid for each pattern
+        if (convertToNumber) {
+            for (size_t i = 0; i < analyses.size(); ++i) {
+                // Number the occurrences in a side table over the original grid rather than a copy of it
+                const pattern_analyzer::NumberedOverlay overlay = pattern_analyzer::number_occurrences(analyses[i]);
+                // Display the numbered grid
+                if (analyses.size() == 1) {
+                    generate_html::generate_paragraph(out, "Pattern Grid with Occurrences Numbered:"); // Add label for the numbered grid
+                } else {
+                    generate_html::generate_paragraph(out, "Pattern Grid with Occurrences of \"" + guessed_patterns[i] + "\" Numbered:");
+                }
+                generate_html::generate_numbered_grid(out, pattern_grid_content, overlay, compact);
+            }
+        }
+
+        // Show analysis and the user's guess result
+        generate_html::generate_heading(out, "Pattern Search Analysis and Guess Result", 2); // Updated heading
+
+        if (guessed_patterns.size() == 1) {
+            // Determine if the user's guess is correct by comparing guessed and actual occurrences
+            bool correct = (guessed_occurrences[0] == actual_occurrence_counts[0]);
+
+            // Display whether the guess was correct and the actual correct count
+            generate_html::generate_result_message(out, correct, guessed_patterns[0], guessed_occurrences[0], actual_occurrence_counts[0]);
+        } else {
+            // One table row per pattern
+            generate_html::generate_results_table(out, guessed_patterns, guessed_occurrences, actual_occurrence_counts);
+        }
+
+        // Removed calls to generate_character_counts as it's not part of the core game result display
+    }
+
+    // Output the closing HTML tags
+    generate_html::generate_html_footer(out);
+}
@@ -0,0 +1,31 @@
+#ifndef REQUEST_HANDLER_H
+#define REQUEST_HANDLER_H
+
+#include <iostream>
+#include "get_validate_input.h"
+#include "html_writer.h"
+#include "pattern_analyzer.h"
+
+using namespace std;
+
+// Namespace for turning a submitted form into the result page, independent of how the form arrived
+namespace request_handler {
+    // Content-Encoding for the page: the compact layout is compressed when the client accepts gzip or deflate
+    html_writer::Encoding response_encoding(const get_validate_input::FormInput& input);
+
+    // The "directions" form field: "all" also finds words written backwards and diagonally, anything
+    // else keeps the original left-to-right and top-to-bottom rules
+    pattern_analyzer::DirectionSet search_directions(const get_validate_input::FormInput& input);
+
+    // Pipelined pages (off unless PROJECT3_PIPELINE=1 is in the environment; never used by project3_server):
+    // for large uploads, the original grid is written while the upload is parsed, the search runs on a
+    // second thread behind the parser, and the numbered grids are written band by band as they become final.
+    // Compressed pages are not pipelined: deflate on the writing thread then outweighs the overlap
+    void set_pipelined(bool pipelined);
+    bool pipelined();
+
+    // Writes the page into out; the caller flushes it
+    void write_result_page(const get_validate_input::FormInput& input, html_writer::Writer& out);
+} // namespace request_handler
+
+#endif // REQUEST_HANDLER_H
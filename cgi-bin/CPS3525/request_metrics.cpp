@@ -0,0 +1,83 @@
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "request_metrics.h"
+
+using namespace std;
+
+static const char* const STAGE_NAMES[request_metrics::STAGE_COUNT] = {
+    "form_read", "parse", "search_h", "search_v", "select", "render", "total"
+};
+
+static const char* const COUNTER_NAMES[request_metrics::COUNTER_COUNT] = {
+    "candidates", "accepted", "bytes_parsed", "bytes_emitted", "cache_hits"
+};
+
+static bool enabled_from_environment() {
+    const char* value = getenv("PROJECT3_METRICS");
+    return value != nullptr && strcmp(value, "0") != 0 && value[0] != '\0';
+}
+
+bool request_metrics::enabled_flag = enabled_from_environment();
+
+static thread_local request_metrics::Record record;
+static thread_local chrono::steady_clock::time_point request_start;
+
+void request_metrics::set_enabled(bool enabled) {
+    enabled_flag = enabled;
+}
+
+request_metrics::Record& request_metrics::current() {
+    return record;
+}
+
+void request_metrics::begin_request() {
+    if (!enabled()) return;
+    memset(&record, 0, sizeof(record));
+    request_start = chrono::steady_clock::now();
+}
+
+void request_metrics::end_request() {
+    if (!enabled()) return;
+    record.stage_ns[TOTAL] = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - request_start).count();
+}
+
+void request_metrics::merge(const Record& other) {
+    if (!enabled()) return;
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        if (s != TOTAL) record.stage_ns[s] += other.stage_ns[s];
+    }
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        record.counters[c] += other.counters[c];
+    }
+}
+
+string request_metrics::log_line() {
+    string line = "{\"event\": \"project3_request\"";
+    char field[96];
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        snprintf(field, sizeof(field), ", \"%s_us\": %.1f", STAGE_NAMES[s], record.stage_ns[s] / 1e3);
+        line += field;
+    }
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        snprintf(field, sizeof(field), ", \"%s\": %lld", COUNTER_NAMES[c], static_cast<long long>(record.counters[c]));
+        line += field;
+    }
+    return line + "}";
+}
+
+string request_metrics::server_timing() {
+    string value;
+    char field[64];
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        snprintf(field, sizeof(field), "%s%s;dur=%.3f", s ? ", " : "", STAGE_NAMES[s], record.stage_ns[s] / 1e6);
+        value += field;
+    }
+    return value;
+}
+
+string request_metrics::html_comment() {
+    return "<!-- metrics: " + log_line() + " -->\n";
+}
@@ -0,0 +1,73 @@
+#ifndef REQUEST_METRICS_H
+#define REQUEST_METRICS_H
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+
+// Namespace for the per-request stage timers and counters. Collection is off unless enabled
+// (PROJECT3_METRICS=1 in the environment, or project3_server --metrics); while off, a timer or
+// counter costs one test of a global flag. Each thread collects into its own record, so the
+// CGI process and every server worker measure the request they are running.
+namespace request_metrics {
+
+    // Stages of one request, in the order they run
+    enum Stage { FORM_READ, PARSE, SEARCH_H, SEARCH_V, SELECT, RENDER, TOTAL, STAGE_COUNT };
+
+    enum Counter { CANDIDATES, ACCEPTED, BYTES_PARSED, BYTES_EMITTED, CACHE_HITS, COUNTER_COUNT };
+
+    struct Record {
+        int64_t stage_ns[STAGE_COUNT];
+        int64_t counters[COUNTER_COUNT];
+    };
+
+    extern bool enabled_flag;
+    inline bool enabled() { return enabled_flag; }
+    void set_enabled(bool enabled);
+
+    // The calling thread's record
+    Record& current();
+
+    // Clears the calling thread's record and starts its TOTAL clock
+    void begin_request();
+    // Stops the TOTAL clock
+    void end_request();
+    // Adds the stages (all but TOTAL) and counters of a record collected by a helper thread of this
+    // request to the calling thread's record; the helper's stages may overlap this thread's
+    void merge(const Record& other);
+
+    inline void add(Counter counter, int64_t amount) {
+        if (enabled()) current().counters[counter] += amount;
+    }
+
+    // Adds the time until the end of the scope to a stage
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Stage stage) : stage_(stage), running_(enabled()) {
+            if (running_) start_ = chrono::steady_clock::now();
+        }
+        ~ScopedTimer() {
+            if (running_) {
+                current().stage_ns[stage_] += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start_).count();
+            }
+        }
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Stage stage_;
+        bool running_;
+        chrono::steady_clock::time_point start_;
+    };
+
+    // The record as one JSON object on one line, for the log
+    string log_line();
+    // The record as a Server-Timing header value (durations in milliseconds)
+    string server_timing();
+    // The record as an HTML comment, for the end of the page
+    string html_comment();
+} // namespace request_metrics
+
+#endif // REQUEST_METRICS_H
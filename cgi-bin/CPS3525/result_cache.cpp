@@ -0,0 +1,349 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "result_cache.h"
+
+using namespace std;
+
+// XXH64 constants
+static const uint64_t PRIME64_1 = 11400714785074694791ULL;
+static const uint64_t PRIME64_2 = 14029467366897019727ULL;
+static const uint64_t PRIME64_3 = 1609587929392839161ULL;
+static const uint64_t PRIME64_4 = 9650029242287828579ULL;
+static const uint64_t PRIME64_5 = 2870177450012600261ULL;
+
+// Tags the on-disk entry format so stale files from another layout are ignored
+static const char DISK_MAGIC[4] = {'P', '3', 'R', 'C'};
+static const uint32_t DISK_VERSION = 1;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge_round(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t result_cache::hash_bytes(const void* data, size_t length, uint64_t seed) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + length;
+    uint64_t h;
+
+    if (length >= 32) {
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        const unsigned char* limit = end - 32;
+        do {
+            v1 = xxh64_round(v1, read64(p));
+            v2 = xxh64_round(v2, read64(p + 8));
+            v3 = xxh64_round(v3, read64(p + 16));
+            v4 = xxh64_round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh64_merge_round(h, v1);
+        h = xxh64_merge_round(h, v2);
+        h = xxh64_merge_round(h, v3);
+        h = xxh64_merge_round(h, v4);
+    } else {
+        h = seed + PRIME64_5;
+    }
+    h += length;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxh64_round(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(read32(p)) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t result_cache::hash_grid(const pattern_grid::Grid& grid) {
+    int dims[2] = {grid.rows(), grid.cols()};
+    uint64_t h = hash_bytes(dims, sizeof(dims));
+    if (grid.empty()) {
+        return h;
+    }
+    if (grid.stride() == static_cast<size_t>(grid.cols())) {
+        return hash_bytes(grid.row(0), static_cast<size_t>(grid.rows()) * grid.cols(), h);
+    }
+    for (int r = 0; r < grid.rows(); ++r) {
+        h = hash_bytes(grid.row(r), grid.cols(), h);
+    }
+    return h;
+}
+
+// Rebuilds the occupancy bitset from the accepted locations of a cached entry
+static void fill_result(int rows, int cols, const vector<pattern_analyzer::PatternLocation>& locations, pattern_analyzer::AnalysisResult& result) {
+    result.locations = locations;
+    result.count = locations.size();
+    result.occupied = pattern_grid::OccupancyBitset(rows, cols);
+    for (const auto& loc : locations) {
+        pattern_analyzer::occupy(result.occupied, loc);
+    }
+}
+
+result_cache::ResultCache::ResultCache(size_t max_entries, size_t max_locations, const string& directory, size_t max_disk_entries)
+    : max_entries_(max_entries), max_locations_(max_locations), stored_locations_(0), directory_(directory),
+      max_disk_entries_(max_disk_entries) {}
+
+// Keys for the original right/down rules keep their old form, so existing disk entries stay valid
+string result_cache::ResultCache::make_key(uint64_t grid_hash, int rows, int cols, const string& pattern, pattern_analyzer::DirectionSet directions) {
+    char prefix[64];
+    if (directions == pattern_analyzer::HORIZONTAL_VERTICAL) {
+        snprintf(prefix, sizeof(prefix), "%016llx-%dx%d-", static_cast<unsigned long long>(grid_hash), rows, cols);
+    } else {
+        snprintf(prefix, sizeof(prefix), "%016llx-%dx%d-d%02x-", static_cast<unsigned long long>(grid_hash), rows, cols, directions);
+    }
+    return prefix + pattern;
+}
+
+// Files are named by a hash of the key (patterns can be long); the full key is stored inside
+string result_cache::ResultCache::disk_path(const string& key) const {
+    char name[40];
+    snprintf(name, sizeof(name), "/%016llx.bin", static_cast<unsigned long long>(hash_bytes(key.data(), key.size())));
+    return directory_ + name;
+}
+
+// True if loc could be an accepted match of a pattern of the given length in a rows x cols grid:
+// a known direction, and its first and last cells inside the grid
+static bool valid_location(const pattern_analyzer::PatternLocation& loc, int rows, int cols, size_t length) {
+    int row_step = 0, col_step = 0;
+    if (!pattern_analyzer::direction_step(loc.direction, row_step, col_step) ||
+        length == 0 || loc.length < 0 || static_cast<size_t>(loc.length) != length) {
+        return false;
+    }
+    long long last_row = loc.row + static_cast<long long>(length - 1) * row_step;
+    long long last_col = loc.col + static_cast<long long>(length - 1) * col_step;
+    return loc.row >= 0 && loc.row < rows && loc.col >= 0 && loc.col < cols &&
+           last_row >= 0 && last_row < rows && last_col >= 0 && last_col < cols;
+}
+
+// An entry whose key matches but whose body is short or out of range is damaged; it is deleted,
+// so the lookup becomes a miss and the fresh result is saved over it
+bool result_cache::ResultCache::load_from_disk(const string& key, int rows, int cols, size_t pattern_length,
+                                               vector<pattern_analyzer::PatternLocation>& locations) const {
+    string path = disk_path(key);
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = false;
+    bool damaged = false;
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t key_length = 0;
+    uint64_t count = 0;
+    if (fread(magic, 1, 4, file) == 4 && memcmp(magic, DISK_MAGIC, 4) == 0 &&
+        fread(&version, sizeof(version), 1, file) == 1 && version == DISK_VERSION &&
+        fread(&key_length, sizeof(key_length), 1, file) == 1 && key_length == key.size()) {
+        string stored_key(key_length, '\0');
+        if (fread(&stored_key[0], 1, key_length, file) == key_length && stored_key == key) {
+            damaged = true; // Until the whole body has been read and checked
+            if (fread(&count, sizeof(count), 1, file) == 1 &&
+                count <= static_cast<uint64_t>(rows) * cols) { // Accepted matches never share a cell
+                vector<int32_t> fields(count * 4);
+                if (count == 0 || fread(fields.data(), sizeof(int32_t), fields.size(), file) == fields.size()) {
+                    locations.resize(count);
+                    damaged = false;
+                    for (size_t i = 0; i < count && !damaged; ++i) {
+                        locations[i].row = fields[i * 4];
+                        locations[i].col = fields[i * 4 + 1];
+                        locations[i].direction = static_cast<char>(fields[i * 4 + 2]);
+                        locations[i].length = fields[i * 4 + 3];
+                        damaged = fields[i * 4 + 2] != locations[i].direction ||
+                                  !valid_location(locations[i], rows, cols, pattern_length);
+                    }
+                    ok = !damaged;
+                }
+            }
+        }
+    }
+    fclose(file);
+    if (damaged) {
+        locations.clear();
+        remove(path.c_str());
+    }
+    return ok;
+}
+
+// Writes to a temporary file and renames it into place, so readers never see a partial entry
+void result_cache::ResultCache::save_to_disk(const string& key, const vector<pattern_analyzer::PatternLocation>& locations) const {
+    string path = disk_path(key);
+    // A temporary file of this writer's own: server threads may store the same key at once
+    string temp_path = path + ".tmpXXXXXX";
+    int fd = mkstemp(&temp_path[0]);
+    if (fd < 0) {
+        return; // The disk store is best effort
+    }
+    fchmod(fd, 0644); // mkstemp makes it private; other CGI processes read it too
+    FILE* file = fdopen(fd, "wb");
+    if (file == nullptr) {
+        close(fd);
+        remove(temp_path.c_str());
+        return;
+    }
+    uint32_t key_length = key.size();
+    uint64_t count = locations.size();
+    vector<int32_t> fields(count * 4);
+    for (size_t i = 0; i < count; ++i) {
+        fields[i * 4] = locations[i].row;
+        fields[i * 4 + 1] = locations[i].col;
+        fields[i * 4 + 2] = locations[i].direction;
+        fields[i * 4 + 3] = locations[i].length;
+    }
+    bool ok = fwrite(DISK_MAGIC, 1, 4, file) == 4 &&
+              fwrite(&DISK_VERSION, sizeof(DISK_VERSION), 1, file) == 1 &&
+              fwrite(&key_length, sizeof(key_length), 1, file) == 1 &&
+              fwrite(key.data(), 1, key_length, file) == key_length &&
+              fwrite(&count, sizeof(count), 1, file) == 1 &&
+              (count == 0 || fwrite(fields.data(), sizeof(int32_t), fields.size(), file) == fields.size());
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+        remove(temp_path.c_str());
+        return;
+    }
+    prune_disk();
+}
+
+// Keeps the directory within max_disk_entries_ entries by deleting the oldest written. Pruning
+// goes down to seven eighths of the limit, so most saves only count the directory's names.
+void result_cache::ResultCache::prune_disk() const {
+    DIR* dir = opendir(directory_.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+    vector<string> names;
+    while (struct dirent* entry = readdir(dir)) {
+        size_t length = strlen(entry->d_name);
+        if (length == 20 && strcmp(entry->d_name + 16, ".bin") == 0) { // disk_path's names
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+    if (names.size() <= max_disk_entries_) {
+        return;
+    }
+    vector<pair<time_t, string>> entries; // Last written, path
+    for (const string& name : names) {
+        string path = directory_ + "/" + name;
+        struct stat info;
+        if (stat(path.c_str(), &info) == 0) {
+            entries.push_back(make_pair(info.st_mtime, path));
+        }
+    }
+    sort(entries.begin(), entries.end());
+    size_t keep = max_disk_entries_ - max_disk_entries_ / 8;
+    for (size_t i = 0; i + keep < entries.size(); ++i) {
+        remove(entries[i].second.c_str()); // Another process may have removed it already
+    }
+}
+
+// Adds an entry at the front of the LRU list and evicts from the back until within bounds
+void result_cache::ResultCache::insert_locked(const string& key, const vector<pattern_analyzer::PatternLocation>& locations) {
+    if (max_entries_ == 0 || locations.size() > max_locations_) {
+        return; // Too large to keep in memory at all
+    }
+    unordered_map<string, list<Entry>::iterator>::iterator existing = index_.find(key);
+    if (existing != index_.end()) {
+        stored_locations_ -= existing->second->locations.size();
+        lru_.erase(existing->second);
+        index_.erase(existing);
+    }
+    lru_.push_front(Entry{key, locations});
+    index_[key] = lru_.begin();
+    stored_locations_ += locations.size();
+
+    while (lru_.size() > max_entries_ || stored_locations_ > max_locations_) {
+        stored_locations_ -= lru_.back().locations.size();
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+}
+
+bool result_cache::ResultCache::lookup(uint64_t grid_hash, int rows, int cols, const string& pattern, pattern_analyzer::DirectionSet directions,
+                                       pattern_analyzer::AnalysisResult& result) {
+    string key = make_key(grid_hash, rows, cols, pattern, directions);
+    {
+        lock_guard<mutex> lock(mutex_);
+        unordered_map<string, list<Entry>::iterator>::iterator hit = index_.find(key);
+        if (hit != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, hit->second); // Mark as most recently used
+            fill_result(rows, cols, hit->second->locations, result);
+            return true;
+        }
+    }
+    if (directory_.empty()) {
+        return false;
+    }
+    vector<pattern_analyzer::PatternLocation> locations;
+    if (!load_from_disk(key, rows, cols, pattern.size(), locations)) {
+        return false;
+    }
+    fill_result(rows, cols, locations, result);
+    lock_guard<mutex> lock(mutex_);
+    insert_locked(key, locations);
+    return true;
+}
+
+void result_cache::ResultCache::store(uint64_t grid_hash, int rows, int cols, const string& pattern, pattern_analyzer::DirectionSet directions,
+                                      const pattern_analyzer::AnalysisResult& result) {
+    string key = make_key(grid_hash, rows, cols, pattern, directions);
+    {
+        lock_guard<mutex> lock(mutex_);
+        insert_locked(key, result.locations);
+    }
+    if (!directory_.empty()) {
+        save_to_disk(key, result.locations);
+    }
+}
+
+result_cache::ResultCache& result_cache::shared_cache() {
+    static ResultCache cache(
+        getenv("PROJECT3_CACHE_ENTRIES") ? strtoul(getenv("PROJECT3_CACHE_ENTRIES"), nullptr, 10) : 256,
+        16u << 20, // Locations kept in memory across all entries
+        getenv("PROJECT3_CACHE_DIR") ? getenv("PROJECT3_CACHE_DIR") : "",
+        getenv("PROJECT3_CACHE_DISK_ENTRIES") ? strtoul(getenv("PROJECT3_CACHE_DISK_ENTRIES"), nullptr, 10) : 4096);
+    return cache;
+}
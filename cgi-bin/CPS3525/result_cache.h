@@ -0,0 +1,70 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "pattern_grid.h"
+#include "pattern_analyzer.h"
+
+using namespace std;
+
+// Namespace for caching analysis results across requests for the same grid and pattern
+namespace result_cache {
+
+    // 64-bit xxHash (XXH64) of data[0, length)
+    uint64_t hash_bytes(const void* data, size_t length, uint64_t seed = 0);
+
+    // Hash of the grid's dimensions and cells
+    uint64_t hash_grid(const pattern_grid::Grid& grid);
+
+    // Accepted locations and counts keyed by (grid hash, dimensions, pattern, search directions).
+    // Recently used entries are kept in memory up to a bound on entries and stored locations;
+    // with a directory configured, entries are also written there so separate CGI processes
+    // can reuse each other's results. The directory keeps at most max_disk_entries entries: a save
+    // that finds more deletes the oldest written until an eighth of the room is free again.
+    class ResultCache {
+    public:
+        ResultCache(size_t max_entries, size_t max_locations, const string& directory, size_t max_disk_entries);
+
+        // Fills result (locations, count and occupancy) and returns true on a hit
+        bool lookup(uint64_t grid_hash, int rows, int cols, const string& pattern, pattern_analyzer::DirectionSet directions,
+                    pattern_analyzer::AnalysisResult& result);
+        void store(uint64_t grid_hash, int rows, int cols, const string& pattern, pattern_analyzer::DirectionSet directions,
+                   const pattern_analyzer::AnalysisResult& result);
+
+    private:
+        struct Entry {
+            string key;
+            vector<pattern_analyzer::PatternLocation> locations;
+        };
+
+        static string make_key(uint64_t grid_hash, int rows, int cols, const string& pattern, pattern_analyzer::DirectionSet directions);
+        string disk_path(const string& key) const;
+        // Reads an entry saved for key; entries that do not fit a rows x cols grid and the pattern length are deleted
+        bool load_from_disk(const string& key, int rows, int cols, size_t pattern_length,
+                            vector<pattern_analyzer::PatternLocation>& locations) const;
+        void save_to_disk(const string& key, const vector<pattern_analyzer::PatternLocation>& locations) const;
+        void prune_disk() const;
+        void insert_locked(const string& key, const vector<pattern_analyzer::PatternLocation>& locations);
+
+        size_t max_entries_;
+        size_t max_locations_;
+        size_t stored_locations_;
+        string directory_;
+        size_t max_disk_entries_;
+        list<Entry> lru_; // Most recently used first
+        unordered_map<string, list<Entry>::iterator> index_;
+        mutex mutex_;
+    };
+
+    // Process-wide cache. PROJECT3_CACHE_DIR enables the on-disk store, PROJECT3_CACHE_ENTRIES
+    // overrides the in-memory entry limit (default 256) and PROJECT3_CACHE_DISK_ENTRIES the
+    // on-disk one (default 4096).
+    ResultCache& shared_cache();
+} // namespace result_cache
+
+#endif // RESULT_CACHE_H
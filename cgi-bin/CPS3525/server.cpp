@@ -0,0 +1,622 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <csignal>
+#include <cerrno>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "get_validate_input.h" // For the form representation and validation
+#include "request_handler.h" // For building the result page
+#include "html_writer.h" // For writing the page into the response buffer
+#include "thread_pool.h" // For the worker pool
+#include "request_metrics.h" // For the optional timing breakdown
+#include "incremental_analyzer.h" // For edit sessions
+
+using namespace std;
+
+// Persistent alternative to the project3 CGI binary: a small HTTP/1.1 server that accepts the
+// same multipart form and returns the same page, without a process launch per request.
+// Usage: project3_server [--port N] [--bind ADDR] [--threads N] [--form FILE] [--metrics]
+// POST to any path runs the game; GET serves FILE (e.g. ../../CPS3525/project3.html) if given.
+// Edit sessions, for editors that resubmit a grid after every change, keep one pattern's analysis
+// between requests and answer with JSON:
+//   POST /edit-session with the game's form (pattern_file, a single guess_pattern, directions)
+//     starts one: {"session": "ID", "count": N}
+//   POST /edit-session/ID with a body of "row col LETTER" lines (0-based) applies those cell edits:
+//     {"session": "ID", "count": N, "added": [[row, col, "H"], ...], "removed": [...]}
+//   DELETE /edit-session/ID ends it. The least recently used session is dropped beyond MAX_EDIT_SESSIONS.
+// --metrics adds a Server-Timing header and a closing HTML comment with the stage timings of each
+// page, and logs them to stderr as one JSON line per request.
+// Pages are always built whole (for their Content-Length, the Server-Timing header and a clean 500 if
+// building fails), so the pipelined page of the CGI program, which pays off by streaming, is not used here.
+
+// Upper limit on a request body; larger uploads get 413
+static const size_t MAX_BODY_BYTES = 256u << 20;
+// Upper limit on the request line plus headers
+static const size_t MAX_HEADER_BYTES = 64u << 10;
+// Idle keep-alive connections are closed after this many seconds
+static const int IDLE_TIMEOUT_SECONDS = 5;
+// Edit sessions kept at once
+static const size_t MAX_EDIT_SESSIONS = 32;
+// Path prefix of the edit session requests
+static const string EDIT_SESSION_PATH = "/edit-session";
+
+struct HttpRequest {
+    string method;
+    string path;
+    string version;
+    map<string, string> headers; // Names lowercased
+    string body;
+};
+
+static string lowercase(string s) {
+    transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return tolower(c); });
+    return s;
+}
+
+static string trim_spaces(const string& s) {
+    size_t first = s.find_first_not_of(" \t");
+    if (first == string::npos) return "";
+    size_t last = s.find_last_not_of(" \t");
+    return s.substr(first, last - first + 1);
+}
+
+static bool send_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+static bool send_response(int fd, int status, const char* reason, const string& content_type,
+                          const string& body, bool keep_alive, const string& extra_headers = "") {
+    string head = "HTTP/1.1 " + to_string(status) + " " + reason + "\r\n";
+    head += "Content-Type: " + content_type + "\r\n";
+    head += "Content-Length: " + to_string(body.size()) + "\r\n";
+    head += keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    head += extra_headers;
+    head += "\r\n";
+    return send_all(fd, head.data(), head.size()) && send_all(fd, body.data(), body.size());
+}
+
+// Reads one request from fd. pending holds bytes already read past the previous request.
+// Returns false on EOF, timeout or malformed input; status is set when an error response is due.
+static bool read_request(int fd, string& pending, HttpRequest& request, int& status) {
+    status = 0;
+    char chunk[16384];
+    size_t header_end;
+    while ((header_end = pending.find("\r\n\r\n")) == string::npos) {
+        if (pending.size() > MAX_HEADER_BYTES) {
+            status = 431;
+            return false;
+        }
+        ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+        if (got <= 0) return false;
+        pending.append(chunk, got);
+    }
+
+    istringstream head(pending.substr(0, header_end));
+    string line;
+    if (!getline(head, line)) {
+        status = 400;
+        return false;
+    }
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    istringstream request_line(line);
+    if (!(request_line >> request.method >> request.path >> request.version)) {
+        status = 400;
+        return false;
+    }
+    request.headers.clear();
+    while (getline(head, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t colon = line.find(':');
+        if (colon == string::npos) continue;
+        request.headers[lowercase(trim_spaces(line.substr(0, colon)))] = trim_spaces(line.substr(colon + 1));
+    }
+
+    size_t content_length = 0;
+    map<string, string>::const_iterator length_iter = request.headers.find("content-length");
+    if (length_iter != request.headers.end()) {
+        char* end = nullptr;
+        unsigned long long parsed = strtoull(length_iter->second.c_str(), &end, 10);
+        if (end == length_iter->second.c_str() || *end != '\0') {
+            status = 400;
+            return false;
+        }
+        if (parsed > MAX_BODY_BYTES) {
+            status = 413;
+            return false;
+        }
+        content_length = parsed;
+    } else if (request.headers.count("transfer-encoding")) {
+        status = 411; // Chunked uploads are not supported
+        return false;
+    }
+
+    size_t body_start = header_end + 4;
+    request.body.assign(pending, body_start, string::npos);
+    request.body.reserve(content_length);
+    // A client that sent "Expect: 100-continue" holds the body back until told to go on (curl waits a second)
+    map<string, string>::const_iterator expect_iter = request.headers.find("expect");
+    if (expect_iter != request.headers.end() && lowercase(expect_iter->second) == "100-continue" &&
+        request.body.size() < content_length) {
+        static const char CONTINUE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        if (!send_all(fd, CONTINUE, sizeof(CONTINUE) - 1)) return false;
+    }
+    while (request.body.size() < content_length) {
+        ssize_t got = recv(fd, chunk, min(sizeof(chunk), content_length - request.body.size()), 0);
+        if (got <= 0) return false;
+        request.body.append(chunk, got);
+    }
+    // Anything past this body belongs to the next pipelined request
+    pending.assign(request.body, content_length, string::npos);
+    request.body.resize(content_length);
+    return true;
+}
+
+// Returns the value of attribute name in a header value like: form-data; name="x"; filename="y"
+static bool header_attribute(const string& header, const string& name, string& value) {
+    size_t pos = 0;
+    while ((pos = header.find(name + "=", pos)) != string::npos) {
+        // Must be a whole attribute name, not the tail of another (e.g. "name" inside "filename")
+        if (pos == 0 || header[pos - 1] == ';' || header[pos - 1] == ' ' || header[pos - 1] == '\t') {
+            size_t start = pos + name.size() + 1;
+            if (start < header.size() && header[start] == '"') {
+                size_t end = header.find('"', start + 1);
+                if (end == string::npos) return false;
+                value = header.substr(start + 1, end - start - 1);
+            } else {
+                size_t end = header.find(';', start);
+                value = trim_spaces(header.substr(start, end == string::npos ? string::npos : end - start));
+            }
+            return true;
+        }
+        pos += name.size();
+    }
+    return false;
+}
+
+// Splits a multipart/form-data body into form fields and the "pattern_file" upload
+static bool parse_multipart(const string& body, const string& boundary, get_validate_input::FormInput& input) {
+    const string delimiter = "--" + boundary;
+    size_t pos = body.find(delimiter);
+    if (pos == string::npos) return false;
+    for (;;) {
+        pos += delimiter.size();
+        if (body.compare(pos, 2, "--") == 0) return true; // Closing delimiter
+        if (body.compare(pos, 2, "\r\n") != 0) return false;
+        pos += 2;
+
+        size_t headers_end = body.find("\r\n\r\n", pos);
+        if (headers_end == string::npos) return false;
+        string part_name, filename;
+        bool is_file = false;
+        size_t line_start = pos;
+        while (line_start < headers_end) {
+            size_t line_end = body.find("\r\n", line_start);
+            if (line_end == string::npos || line_end > headers_end) line_end = headers_end;
+            string line = body.substr(line_start, line_end - line_start);
+            size_t colon = line.find(':');
+            if (colon != string::npos && lowercase(trim_spaces(line.substr(0, colon))) == "content-disposition") {
+                string value = line.substr(colon + 1);
+                header_attribute(value, "name", part_name);
+                is_file = header_attribute(value, "filename", filename);
+            }
+            line_start = line_end + 2;
+        }
+
+        size_t data_start = headers_end + 4;
+        size_t next = body.find("\r\n" + delimiter, data_start);
+        if (next == string::npos) return false;
+
+        if (is_file) {
+            if (part_name == "pattern_file" && !input.has_pattern_file) {
+                input.has_pattern_file = true;
+                input.pattern_file.assign(body, data_start, next - data_start);
+            }
+        } else if (!part_name.empty()) {
+            input.fields.insert(make_pair(part_name, body.substr(data_start, next - data_start)));
+        }
+        pos = next + 2;
+    }
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static string url_decode(const string& s) {
+    string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '+') {
+            out += ' ';
+        } else if (s[i] == '%' && i + 2 < s.size() && hex_value(s[i + 1]) >= 0 && hex_value(s[i + 2]) >= 0) {
+            out += static_cast<char>(hex_value(s[i + 1]) * 16 + hex_value(s[i + 2]));
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+// application/x-www-form-urlencoded bodies carry fields only (no file)
+static void parse_urlencoded(const string& body, get_validate_input::FormInput& input) {
+    size_t start = 0;
+    while (start <= body.size()) {
+        size_t end = body.find('&', start);
+        if (end == string::npos) end = body.size();
+        string pair = body.substr(start, end - start);
+        size_t eq = pair.find('=');
+        if (!pair.empty()) {
+            string name = url_decode(pair.substr(0, eq));
+            string value = eq == string::npos ? "" : url_decode(pair.substr(eq + 1));
+            input.fields.insert(make_pair(name, value));
+        }
+        start = end + 1;
+    }
+}
+
+// Turns the request body into a FormInput the same way cgicc would have
+static void read_http_form(const HttpRequest& request, get_validate_input::FormInput& input) {
+    map<string, string>::const_iterator type_iter = request.headers.find("content-type");
+    string content_type = type_iter == request.headers.end() ? "" : type_iter->second;
+    string boundary;
+    if (lowercase(content_type).find("multipart/form-data") == 0) {
+        if (!header_attribute(content_type, "boundary", boundary) || boundary.empty() ||
+            !parse_multipart(request.body, boundary, input)) {
+            input.error = "Exception caught during form data processing: malformed multipart/form-data body";
+        }
+    } else {
+        parse_urlencoded(request.body, input);
+    }
+}
+
+// One grid being edited. Requests for the same session are applied one at a time.
+struct EditSession {
+    EditSession(const pattern_grid::Grid& grid, const string& pattern, pattern_analyzer::DirectionSet directions)
+        : analysis(grid, pattern, directions), last_used(0) {}
+    mutex lock;
+    incremental_analyzer::Analysis analysis;
+    unsigned long long last_used; // Value of session_clock when last looked up
+};
+
+static mutex sessions_lock;
+static map<string, shared_ptr<EditSession>> sessions;
+static unsigned long long session_clock = 0;
+
+static string new_session_id() {
+    static mt19937_64 generator{random_device{}()}; // Guarded by sessions_lock
+    char id[17];
+    snprintf(id, sizeof(id), "%016llx", static_cast<unsigned long long>(generator()));
+    return id;
+}
+
+static string add_session(shared_ptr<EditSession> session) {
+    lock_guard<mutex> guard(sessions_lock);
+    if (sessions.size() >= MAX_EDIT_SESSIONS) {
+        map<string, shared_ptr<EditSession>>::iterator oldest = sessions.begin();
+        for (map<string, shared_ptr<EditSession>>::iterator it = sessions.begin(); it != sessions.end(); ++it) {
+            if (it->second->last_used < oldest->second->last_used) oldest = it;
+        }
+        sessions.erase(oldest);
+    }
+    string id;
+    do {
+        id = new_session_id();
+    } while (sessions.count(id));
+    session->last_used = ++session_clock;
+    sessions[id] = session;
+    return id;
+}
+
+static shared_ptr<EditSession> find_session(const string& id) {
+    lock_guard<mutex> guard(sessions_lock);
+    map<string, shared_ptr<EditSession>>::iterator it = sessions.find(id);
+    if (it == sessions.end()) return nullptr;
+    it->second->last_used = ++session_clock;
+    return it->second;
+}
+
+static bool remove_session(const string& id) {
+    lock_guard<mutex> guard(sessions_lock);
+    return sessions.erase(id) > 0;
+}
+
+static void append_locations(string& json, const vector<pattern_analyzer::PatternLocation>& locations) {
+    json += "[";
+    char item[64];
+    for (size_t i = 0; i < locations.size(); ++i) {
+        snprintf(item, sizeof(item), "%s[%d, %d, \"%c\"]", i ? ", " : "", locations[i].row, locations[i].col, locations[i].direction);
+        json += item;
+    }
+    json += "]";
+}
+
+// Starts a session from the game's form; on failure status and message are set instead
+static string start_edit_session(const HttpRequest& request, int& status, string& message) {
+    get_validate_input::FormInput input;
+    read_http_form(request, input);
+    map<string, string>::const_iterator pattern = input.fields.find("guess_pattern");
+    string pattern_text = pattern == input.fields.end() ? "" : get_validate_input::trim(pattern->second);
+    ostringstream errors;
+    pattern_grid::Grid grid;
+    status = 400;
+    if (!input.error.empty()) {
+        message = input.error;
+    } else if (pattern_text.empty() || !get_validate_input::is_uppercase(pattern_text)) {
+        message = "Expected a single uppercase guess_pattern";
+    } else if (!input.has_pattern_file) {
+        message = "File input field 'pattern_file' not found";
+    } else if (!get_validate_input::parse_grid(input.pattern_file.data(), input.pattern_file.size(), grid, errors)) {
+        message = errors.str();
+    } else {
+        shared_ptr<EditSession> session = make_shared<EditSession>(grid, pattern_text, request_handler::search_directions(input));
+        int count = session->analysis.count();
+        string id = add_session(session);
+        status = 200;
+        return "{\"session\": \"" + id + "\", \"count\": " + to_string(count) + "}\n";
+    }
+    return "";
+}
+
+// Applies the "row col LETTER" lines of the body to a session
+static string edit_session(const string& id, const string& body, int& status, string& message) {
+    shared_ptr<EditSession> session = find_session(id);
+    if (!session) {
+        status = 404;
+        message = "No such edit session";
+        return "";
+    }
+    vector<incremental_analyzer::CellEdit> edits;
+    istringstream lines(body);
+    incremental_analyzer::CellEdit edit;
+    string line, value, extra;
+    while (getline(lines, line)) {
+        if (line.find_first_not_of(" \t\r") == string::npos) continue; // Blank line
+        istringstream fields(line);
+        if (!(fields >> edit.row >> edit.col >> value) || fields >> extra) { // Also a partial last line
+            status = 400;
+            message = "Expected \"row col LETTER\" lines";
+            return "";
+        }
+        if (value.size() != 1 || !get_validate_input::is_uppercase(value)) {
+            status = 400;
+            message = "Expected \"row col LETTER\" lines with an uppercase letter";
+            return "";
+        }
+        edit.value = value[0];
+        edits.push_back(edit);
+    }
+
+    lock_guard<mutex> guard(session->lock);
+    incremental_analyzer::Delta delta;
+    if (!session->analysis.apply(edits, delta)) {
+        status = 400;
+        message = "Edited cell outside the grid";
+        return "";
+    }
+    status = 200;
+    string json = "{\"session\": \"" + id + "\", \"count\": " + to_string(session->analysis.count()) + ", \"added\": ";
+    append_locations(json, delta.added);
+    json += ", \"removed\": ";
+    append_locations(json, delta.removed);
+    return json + "}\n";
+}
+
+// Answers a request under EDIT_SESSION_PATH
+static bool serve_edit_session(int fd, const HttpRequest& request, bool keep_alive) {
+    string rest = request.path.substr(EDIT_SESSION_PATH.size());
+    string id = rest.size() > 1 && rest[0] == '/' ? rest.substr(1) : "";
+    int status = 405;
+    string message = "Method not allowed";
+    string body;
+    try {
+        if (request.method == "POST" && rest.empty()) {
+            body = start_edit_session(request, status, message);
+        } else if (request.method == "POST" && !id.empty()) {
+            body = edit_session(id, request.body, status, message);
+        } else if (request.method == "DELETE" && !id.empty()) {
+            status = remove_session(id) ? 200 : 404;
+            message = "No such edit session";
+            body = "{\"session\": \"" + id + "\", \"closed\": true}\n";
+        }
+    } catch (const exception& e) {
+        // e.g. bad_alloc analyzing a huge grid: answer this request and keep serving the connection.
+        // An edit cut short may have left its session half updated, so the session is dropped.
+        cerr << "Exception caught in an edit session request: " << e.what() << endl;
+        if (!id.empty()) remove_session(id);
+        return send_response(fd, 500, "Internal Server Error", "text/plain", "The edit session request failed\n", keep_alive);
+    }
+    switch (status) {
+        case 200: return send_response(fd, 200, "OK", "application/json", body, keep_alive);
+        case 404: return send_response(fd, 404, "Not Found", "text/plain", message + "\n", keep_alive);
+        case 405: return send_response(fd, 405, "Method Not Allowed", "text/plain", message + "\n", keep_alive, "Allow: POST, DELETE\r\n");
+        default: return send_response(fd, 400, "Bad Request", "text/plain", message + "\n", keep_alive);
+    }
+}
+
+struct ServerConfig {
+    int port = 8080;
+    string bind_address = "127.0.0.1";
+    int threads = 0; // 0 = one per hardware thread
+    string form_file;
+};
+
+// Serves every request on one connection until the client closes it or stops asking for keep-alive
+static void serve_connection(int fd, const ServerConfig& config) {
+    // Per-worker buffers keep their capacity from one request to the next
+    thread_local string pending;
+    thread_local string page;
+    thread_local html_writer::Writer writer(page); // Its chunk buffer is reused too
+    thread_local HttpRequest request;
+    pending.clear();
+
+    for (;;) {
+        int status = 0;
+        if (!read_request(fd, pending, request, status)) {
+            if (status == 413) send_response(fd, 413, "Payload Too Large", "text/plain", "Upload too large\n", false);
+            else if (status == 411) send_response(fd, 411, "Length Required", "text/plain", "Content-Length required\n", false);
+            else if (status == 431) send_response(fd, 431, "Request Header Fields Too Large", "text/plain", "Headers too large\n", false);
+            else if (status != 0) send_response(fd, 400, "Bad Request", "text/plain", "Bad request\n", false);
+            break;
+        }
+
+        map<string, string>::const_iterator connection = request.headers.find("connection");
+        bool keep_alive = request.version == "HTTP/1.1"
+            ? !(connection != request.headers.end() && lowercase(connection->second) == "close")
+            : (connection != request.headers.end() && lowercase(connection->second) == "keep-alive");
+
+        bool sent;
+        if (request.path.compare(0, EDIT_SESSION_PATH.size(), EDIT_SESSION_PATH) == 0 &&
+            (request.path.size() == EDIT_SESSION_PATH.size() || request.path[EDIT_SESSION_PATH.size()] == '/')) {
+            sent = serve_edit_session(fd, request, keep_alive);
+        } else if (request.method == "POST") {
+            // Whatever a failed request left in the writer must not reach this page
+            writer.reset();
+            page.clear();
+            try {
+                request_metrics::begin_request();
+                get_validate_input::FormInput input;
+                {
+                    request_metrics::ScopedTimer timer(request_metrics::FORM_READ);
+                    read_http_form(request, input);
+                }
+                map<string, string>::const_iterator accept = request.headers.find("accept-encoding");
+                if (accept != request.headers.end()) input.accept_encoding = accept->second;
+                size_t written_before = writer.bytes_written();
+                writer.begin_encoding(request_handler::response_encoding(input));
+                html_writer::Encoding encoding = writer.encoding(); // What was asked for, unless zlib failed
+                request_handler::write_result_page(input, writer);
+                string extra_headers = encoding == html_writer::IDENTITY ? "" :
+                    string("Content-Encoding: ") + html_writer::encoding_name(encoding) + "\r\nVary: Accept-Encoding\r\n";
+                if (request_metrics::enabled()) {
+                    request_metrics::end_request();
+                    request_metrics::add(request_metrics::BYTES_EMITTED, writer.bytes_written() - written_before);
+                    writer.raw(request_metrics::html_comment());
+                    extra_headers += "Server-Timing: " + request_metrics::server_timing() + "\r\n";
+                    cerr << request_metrics::log_line() + "\n" << flush; // One write, so worker lines do not interleave
+                }
+                writer.finish();
+                sent = send_response(fd, 200, "OK", "text/html", page, keep_alive, extra_headers);
+            } catch (const exception& e) {
+                // e.g. bad_alloc on a huge upload: answer this request and keep serving the connection
+                cerr << "Exception caught while building a page: " << e.what() << endl;
+                writer.reset();
+                page.clear();
+                sent = send_response(fd, 500, "Internal Server Error", "text/plain", "The page could not be built\n", keep_alive);
+            }
+        } else if (request.method == "GET" && !config.form_file.empty()) {
+            ifstream form(config.form_file.c_str(), ios::binary);
+            stringstream contents;
+            contents << form.rdbuf();
+            sent = form ? send_response(fd, 200, "OK", "text/html", contents.str(), keep_alive)
+                        : send_response(fd, 404, "Not Found", "text/plain", "Not found\n", keep_alive);
+        } else {
+            sent = send_response(fd, 405, "Method Not Allowed", "text/plain", "Method not allowed\n", keep_alive, "Allow: GET, POST\r\n");
+        }
+        if (!sent || !keep_alive) break;
+    }
+    close(fd);
+}
+
+static bool parse_args(int argc, char* argv[], ServerConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--metrics") {
+            request_metrics::set_enabled(true);
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        if (arg == "--port") config.port = atoi(argv[++i]);
+        else if (arg == "--bind") config.bind_address = argv[++i];
+        else if (arg == "--threads") config.threads = atoi(argv[++i]);
+        else if (arg == "--form") config.form_file = argv[++i];
+        else return false;
+    }
+    return config.port > 0 && config.port < 65536 && config.threads >= 0;
+}
+
+int main(int argc, char* argv[]) {
+    ServerConfig config;
+    if (!parse_args(argc, argv, config)) {
+        cerr << "Usage: " << argv[0] << " [--port N] [--bind ADDR] [--threads N] [--form FILE] [--metrics]" << endl;
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    request_handler::set_pipelined(false); // Even with PROJECT3_PIPELINE set (see above)
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.port);
+    if (inet_pton(AF_INET, config.bind_address.c_str(), &address.sin_addr) != 1) {
+        cerr << "Invalid bind address: " << config.bind_address << endl;
+        return 2;
+    }
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listener, 128) < 0) {
+        perror("bind/listen");
+        return 1;
+    }
+
+    int threads = config.threads > 0 ? config.threads : max(1u, thread::hardware_concurrency());
+    thread_pool::ThreadPool workers(threads);
+    cerr << "project3_server listening on " << config.bind_address << ":" << config.port
+         << " with " << threads << " worker(s)" << endl;
+
+    for (;;) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            continue;
+        }
+        timeval timeout;
+        timeout.tv_sec = IDLE_TIMEOUT_SECONDS;
+        timeout.tv_usec = 0;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        workers.submit([fd, &config] {
+            try {
+                serve_connection(fd, config);
+            } catch (const exception& e) {
+                cerr << "Exception caught while serving a connection: " << e.what() << endl;
+                close(fd);
+            }
+        });
+    }
+}
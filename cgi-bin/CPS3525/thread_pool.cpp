@@ -0,0 +1,105 @@
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include "thread_pool.h"
+
+using namespace std;
+
+thread_pool::ThreadPool::ThreadPool(int threads) : stopping_(false) {
+    threads = max(threads, 1);
+    for (int i = 0; i < threads; ++i) {
+        workers_.push_back(thread(&ThreadPool::worker_loop, this));
+    }
+}
+
+thread_pool::ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void thread_pool::ThreadPool::submit(function<void()> task) {
+    {
+        lock_guard<mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+void thread_pool::ThreadPool::worker_loop() {
+    for (;;) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return; // Stopping and nothing left to run
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+// Shared by the caller and the helper tasks of one for_each_band call
+struct BandBatch {
+    function<void(int)> fn;
+    int bands;
+    atomic<int> next;
+    atomic<int> finished;
+    mutex done_mutex;
+    condition_variable done;
+    exception_ptr error;
+
+    // Claims and runs bands until none are left
+    void run() {
+        for (int band = next++; band < bands; band = next++) {
+            try {
+                fn(band);
+            } catch (...) {
+                lock_guard<mutex> lock(done_mutex);
+                if (!error) error = current_exception();
+            }
+            if (++finished == bands) {
+                lock_guard<mutex> lock(done_mutex);
+                done.notify_all();
+            }
+        }
+    }
+};
+
+void thread_pool::ThreadPool::for_each_band(int bands, const function<void(int)>& fn) {
+    if (bands <= 0) {
+        return;
+    }
+    shared_ptr<BandBatch> batch = make_shared<BandBatch>();
+    batch->fn = fn;
+    batch->bands = bands;
+    batch->next = 0;
+    batch->finished = 0;
+
+    int helpers = min(size(), bands - 1);
+    for (int i = 0; i < helpers; ++i) {
+        submit([batch] { batch->run(); });
+    }
+    batch->run();
+
+    unique_lock<mutex> lock(batch->done_mutex);
+    batch->done.wait(lock, [&batch] { return batch->finished == batch->bands; });
+    if (batch->error) {
+        rethrow_exception(batch->error);
+    }
+}
+
+thread_pool::ThreadPool& thread_pool::shared_pool() {
+    static ThreadPool pool(max(1u, thread::hardware_concurrency()));
+    return pool;
+}
@@ -0,0 +1,49 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+// Namespace for the worker threads shared by the parallel search and the batch/server front ends
+namespace thread_pool {
+
+    // Fixed set of worker threads pulling tasks from one queue
+    class ThreadPool {
+    public:
+        explicit ThreadPool(int threads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        int size() const { return workers_.size(); }
+
+        // Queues a task to run on one of the workers
+        void submit(function<void()> task);
+
+        // Runs fn(band) for every band in [0, bands) and returns once all of them are done.
+        // The calling thread works on bands too, so this is safe to call from inside a task
+        // even when every worker is busy. The first exception thrown by fn is rethrown here.
+        void for_each_band(int bands, const function<void(int)>& fn);
+
+    private:
+        void worker_loop();
+
+        vector<thread> workers_;
+        deque<function<void()>> tasks_;
+        mutex mutex_;
+        condition_variable wake_;
+        bool stopping_;
+    };
+
+    // Process-wide pool with one worker per hardware thread, created on first use
+    ThreadPool& shared_pool();
+} // namespace thread_pool
+
+#endif // THREAD_POOL_H